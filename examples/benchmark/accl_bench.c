@@ -0,0 +1,626 @@
+/* This research is supported by the European Union Seventh Framework Programme (FP7/2007-2013), project ASPIRE (Advanced  Software Protection: Integration, Research, and Exploitation), under grant agreement no. 609734; on-line at https://aspire-fp7.eu/. */
+
+/*
+	ASPIRE Client-side Communication Logic
+
+	accl_bench.c - throughput, latency percentiles and allocations per call
+	of every public API, run against mock_portal (or a real portal)
+
+	allocations are counted through the linker (--wrap=malloc, ...), so
+	they cover the ACCL and this harness but not the shared libraries
+	(cURL, libwebsockets, zlib) it calls into
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <accl.h>
+
+/* allocation counters (see the wrappers below) */
+static unsigned long long allocations = 0;
+static unsigned long long allocated_bytes = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+int __real_posix_memalign(void** ptr, size_t alignment, size_t size);
+
+void* __wrap_malloc(size_t size) {
+	__atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&allocated_bytes, size, __ATOMIC_RELAXED);
+
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+	__atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&allocated_bytes, count * size, __ATOMIC_RELAXED);
+
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+	__atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&allocated_bytes, size, __ATOMIC_RELAXED);
+
+	return __real_realloc(ptr, size);
+}
+
+int __wrap_posix_memalign(void** ptr, size_t alignment, size_t size) {
+	__atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&allocated_bytes, size, __ATOMIC_RELAXED);
+
+	return __real_posix_memalign(ptr, alignment, size);
+}
+
+/* run parameters (command line) */
+typedef struct bench_config {
+	unsigned int calls;				/* measured calls per API */
+	unsigned int warmup;			/* unmeasured calls per thread */
+	unsigned int threads;
+	unsigned int payload_size;
+	unsigned int depth;				/* outstanding async requests / batch size */
+	int technique_id;
+} bench_config;
+
+static bench_config config = {
+	10000,
+	16,
+	1,
+	256,
+	16,
+	ACCL_TID_TEST
+};
+
+static char* payload;
+
+typedef struct bench_thread bench_thread;
+
+typedef struct bench_api {
+	const char* name;
+	int (*call)(bench_thread* thread, unsigned int index);
+	int (*setup)(bench_thread* thread);
+	void (*teardown)(bench_thread* thread);
+	int pipelined;					/* latency recorded on completion */
+} bench_api;
+
+struct bench_thread {
+	pthread_t thread;
+	const bench_api* api;
+	unsigned int calls;
+	unsigned long long* latencies;	/* nanoseconds, one per call */
+	unsigned int errors;
+	int recording;					/* 0 during warmup */
+	char* response;					/* caller supplied response buffer */
+	unsigned int produced;			/* chunked uploads progress */
+	unsigned long long streamed;
+	sem_t window;					/* async requests in flight */
+	unsigned long long* submitted;	/* async submission times */
+	accl_batch_entry* entries;
+#ifndef WITHOUT_WEBSOCKETS
+	struct libwebsocket_context* context;
+#endif
+};
+
+static unsigned long long bench_now(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+/*
+	HTTP APIs
+*/
+static int bench_exchange(bench_thread* thread, unsigned int index) {
+	unsigned int size = 0;
+	char* response = NULL;
+	int returnValue;
+
+	returnValue = acclExchange(config.technique_id, config.payload_size, payload, &size, &response);
+	free(response);
+
+	return returnValue;
+}
+
+static int bench_response_setup(bench_thread* thread) {
+	thread->response = (char*)malloc(ACCL_MAX_BUFFER_SIZE);
+
+	return (NULL != thread->response) ? ACCL_SUCCESS : ACCL_GENERIC_ERROR;
+}
+
+static void bench_response_teardown(bench_thread* thread) {
+	free(thread->response);
+}
+
+static int bench_exchange_into(bench_thread* thread, unsigned int index) {
+	unsigned int size = 0;
+
+	return acclExchangeInto(config.technique_id, config.payload_size, payload,
+		ACCL_MAX_BUFFER_SIZE, thread->response, &size);
+}
+
+/* the payload split in four segments */
+static void bench_segments(accl_iovec* segments) {
+	unsigned int quarter = config.payload_size / 4;
+	unsigned int i;
+
+	for (i = 0; i < 4; i++) {
+		segments[i].base = payload + i * quarter;
+		segments[i].length = (i < 3) ? quarter : config.payload_size - 3 * quarter;
+	}
+}
+
+static int bench_exchange_v(bench_thread* thread, unsigned int index) {
+	accl_iovec segments[4];
+	unsigned int size = 0;
+	char* response = NULL;
+	int returnValue;
+
+	bench_segments(segments);
+
+	returnValue = acclExchangeV(config.technique_id, segments, 4, &size, &response);
+	free(response);
+
+	return returnValue;
+}
+
+static int bench_stream_chunk(const char* chunk, unsigned int chunkSize, void* user_data) {
+	((bench_thread*)user_data)->streamed += chunkSize;
+
+	return 0;
+}
+
+static int bench_exchange_stream(bench_thread* thread, unsigned int index) {
+	return acclExchangeStream(config.technique_id, config.payload_size, payload,
+		bench_stream_chunk, thread);
+}
+
+/* produces the payload in ACCL_UPLOAD_CHUNK_SIZE (or smaller) pieces */
+static int bench_produce(char* buffer, unsigned int bufferSize, void* user_data) {
+	bench_thread* thread = (bench_thread*)user_data;
+	unsigned int size = MIN(bufferSize, config.payload_size - thread->produced);
+
+	memcpy(buffer, payload + thread->produced, size);
+	thread->produced += size;
+
+	return (int)size;
+}
+
+static int bench_exchange_chunked(bench_thread* thread, unsigned int index) {
+	unsigned int size = 0;
+	char* response = NULL;
+	int returnValue;
+
+	thread->produced = 0;
+
+	returnValue = acclExchangeChunked(config.technique_id, bench_produce, thread, &size, &response);
+	free(response);
+
+	return returnValue;
+}
+
+static int bench_send(bench_thread* thread, unsigned int index) {
+	return acclSend(config.technique_id, config.payload_size, payload);
+}
+
+static int bench_send_v(bench_thread* thread, unsigned int index) {
+	accl_iovec segments[4];
+
+	bench_segments(segments);
+
+	return acclSendV(config.technique_id, segments, 4);
+}
+
+static int bench_send_chunked(bench_thread* thread, unsigned int index) {
+	thread->produced = 0;
+
+	return acclSendChunked(config.technique_id, bench_produce, thread);
+}
+
+/*
+	Asynchronous APIs: up to depth requests in flight per thread
+*/
+typedef struct bench_async_call {
+	bench_thread* thread;
+	unsigned int index;
+} bench_async_call;
+
+static int bench_async_setup(bench_thread* thread) {
+	thread->submitted = (unsigned long long*)malloc(sizeof(unsigned long long) * (thread->calls + config.warmup));
+
+	if (NULL == thread->submitted)
+		return ACCL_GENERIC_ERROR;
+
+	sem_init(&thread->window, 0, config.depth);
+
+	return ACCL_SUCCESS;
+}
+
+static void bench_async_teardown(bench_thread* thread) {
+	sem_destroy(&thread->window);
+	free(thread->submitted);
+}
+
+static void bench_async_done(int error, unsigned int returnBufferSize, char* pReturnBuffer, void* user_data) {
+	bench_async_call* call = (bench_async_call*)user_data;
+	bench_thread* thread = call->thread;
+	unsigned int index = call->index;
+
+	free(pReturnBuffer);
+	free(call);
+
+	if (ACCL_SUCCESS != error)
+		__atomic_fetch_add(&thread->errors, 1, __ATOMIC_RELAXED);
+
+	// warmup calls are numbered after the measured ones
+	if (index < thread->calls)
+		thread->latencies[index] = bench_now() - thread->submitted[index];
+
+	sem_post(&thread->window);
+}
+
+static int bench_exchange_async(bench_thread* thread, unsigned int index) {
+	bench_async_call* call = (bench_async_call*)malloc(sizeof(bench_async_call));
+	int returnValue;
+
+	if (NULL == call)
+		return ACCL_GENERIC_ERROR;
+
+	call->thread = thread;
+	call->index = thread->recording ? index : thread->calls + index;
+
+	sem_wait(&thread->window);
+
+	thread->submitted[call->index] = bench_now();
+
+	returnValue = acclExchangeAsync(config.technique_id, config.payload_size, payload,
+		bench_async_done, call);
+
+	if (ACCL_SUCCESS != returnValue) {
+		free(call);
+		sem_post(&thread->window);
+	}
+
+	return returnValue;
+}
+
+static void bench_async_drain(bench_thread* thread) {
+	unsigned int i;
+
+	for (i = 0; i < config.depth; i++)
+		sem_wait(&thread->window);
+
+	for (i = 0; i < config.depth; i++)
+		sem_post(&thread->window);
+}
+
+static int bench_batch_setup(bench_thread* thread) {
+	thread->entries = (accl_batch_entry*)calloc(config.depth, sizeof(accl_batch_entry));
+
+	return (NULL != thread->entries) ? ACCL_SUCCESS : ACCL_GENERIC_ERROR;
+}
+
+static void bench_batch_teardown(bench_thread* thread) {
+	free(thread->entries);
+}
+
+static int bench_exchange_batch(bench_thread* thread, unsigned int index) {
+	unsigned int i;
+	int returnValue;
+
+	for (i = 0; i < config.depth; i++) {
+		thread->entries[i].technique_id = config.technique_id;
+		thread->entries[i].payload_size = config.payload_size;
+		thread->entries[i].payload_buffer = payload;
+	}
+
+	returnValue = acclExchangeBatch(thread->entries, config.depth);
+
+	for (i = 0; i < config.depth; i++)
+		free(thread->entries[i].return_buffer);
+
+	return returnValue;
+}
+
+#ifndef WITHOUT_WEBSOCKETS
+/*
+	WebSocket APIs, one channel per thread
+*/
+static void* bench_ws_callback(void* data, size_t size) {
+	return NULL;
+}
+
+static int bench_ws_setup(bench_thread* thread) {
+	if (ACCL_SUCCESS != bench_response_setup(thread))
+		return ACCL_GENERIC_ERROR;
+
+	thread->context = acclWebSocketInit(config.technique_id, bench_ws_callback);
+
+	return (NULL != thread->context) ? ACCL_SUCCESS : ACCL_WS_INVALID_CONTEXT;
+}
+
+static void bench_ws_teardown(bench_thread* thread) {
+	if (NULL != thread->context)
+		acclWebSocketShutdown(thread->context);
+
+	bench_response_teardown(thread);
+}
+
+static int bench_ws_send(bench_thread* thread, unsigned int index) {
+	return acclWebSocketSend(thread->context, config.payload_size, payload);
+}
+
+static int bench_ws_exchange(bench_thread* thread, unsigned int index) {
+	return acclWebSocketExchange(thread->context, config.payload_size, payload,
+		ACCL_MAX_BUFFER_SIZE, thread->response);
+}
+
+/*
+	One channel shared by every thread, exchanges multiplexed on it
+	(setup and teardown run on the main thread, one thread after the other)
+*/
+static struct libwebsocket_context* shared_context = NULL;
+static unsigned int shared_users = 0;
+
+static int bench_ws_shared_setup(bench_thread* thread) {
+	if (ACCL_SUCCESS != bench_response_setup(thread))
+		return ACCL_GENERIC_ERROR;
+
+	if (0 == shared_users)
+		shared_context = acclWebSocketInit(config.technique_id, bench_ws_callback);
+
+	if (NULL == shared_context)
+		return ACCL_WS_INVALID_CONTEXT;
+
+	shared_users++;
+	thread->context = shared_context;
+
+	return ACCL_SUCCESS;
+}
+
+static void bench_ws_shared_teardown(bench_thread* thread) {
+	if (NULL != thread->context && 0 == --shared_users) {
+		acclWebSocketShutdown(shared_context);
+		shared_context = NULL;
+	}
+
+	bench_response_teardown(thread);
+}
+#endif /* WITHOUT_WEBSOCKETS */
+
+static const bench_api apis[] = {
+	{ "exchange",			bench_exchange,			NULL,					NULL,						0 },
+	{ "exchange_into",		bench_exchange_into,	bench_response_setup,	bench_response_teardown,	0 },
+	{ "exchange_v",			bench_exchange_v,		NULL,					NULL,						0 },
+	{ "exchange_stream",	bench_exchange_stream,	NULL,					NULL,						0 },
+	{ "exchange_chunked",	bench_exchange_chunked,	NULL,					NULL,						0 },
+	{ "exchange_async",		bench_exchange_async,	bench_async_setup,		bench_async_teardown,		1 },
+	{ "exchange_batch",		bench_exchange_batch,	bench_batch_setup,		bench_batch_teardown,		0 },
+	{ "send",				bench_send,				NULL,					NULL,						0 },
+	{ "send_v",				bench_send_v,			NULL,					NULL,						0 },
+	{ "send_chunked",		bench_send_chunked,		NULL,					NULL,						0 },
+#ifndef WITHOUT_WEBSOCKETS
+	{ "ws_send",			bench_ws_send,			bench_ws_setup,			bench_ws_teardown,			0 },
+	{ "ws_exchange",		bench_ws_exchange,		bench_ws_setup,			bench_ws_teardown,			0 },
+	{ "ws_exchange_shared",	bench_ws_exchange,		bench_ws_shared_setup,	bench_ws_shared_teardown,	0 },
+#endif
+};
+
+#define BENCH_API_COUNT		(sizeof(apis) / sizeof(apis[0]))
+
+static pthread_barrier_t start_barrier;
+
+static void* bench_worker(void* arg) {
+	bench_thread* thread = (bench_thread*)arg;
+	unsigned long long started;
+	unsigned int i;
+	int returnValue;
+
+	for (i = 0; i < config.warmup; i++)
+		thread->api->call(thread, i);
+
+	if (thread->api->pipelined)
+		bench_async_drain(thread);
+
+	thread->errors = 0;
+	thread->recording = 1;
+
+	pthread_barrier_wait(&start_barrier);
+
+	for (i = 0; i < thread->calls; i++) {
+		started = bench_now();
+
+		returnValue = thread->api->call(thread, i);
+
+		if (!thread->api->pipelined)
+			thread->latencies[i] = bench_now() - started;
+
+		if (ACCL_SUCCESS != returnValue)
+			__atomic_fetch_add(&thread->errors, 1, __ATOMIC_RELAXED);
+	}
+
+	if (thread->api->pipelined)
+		bench_async_drain(thread);
+
+	pthread_barrier_wait(&start_barrier);
+
+	return NULL;
+}
+
+static int bench_compare(const void* a, const void* b) {
+	unsigned long long x = *(const unsigned long long*)a;
+	unsigned long long y = *(const unsigned long long*)b;
+
+	return (x > y) - (x < y);
+}
+
+static double bench_percentile(const unsigned long long* sorted, unsigned int count, double quantile) {
+	unsigned int rank = (unsigned int)(quantile * count);
+
+	if (0 == count)
+		return 0.0;
+
+	return sorted[MIN(rank, count - 1)] / 1000.0;
+}
+
+/*
+	Runs one API on every thread and prints a report line
+*/
+static int bench_run(const bench_api* api) {
+	bench_thread* threads;
+	unsigned long long* latencies;
+	unsigned long long started, elapsed;
+	unsigned long long allocations_before, bytes_before;
+	unsigned long long allocations_after, bytes_after;
+	unsigned int errors = 0;
+	unsigned int offset = 0;
+	unsigned int i;
+
+	threads = (bench_thread*)calloc(config.threads, sizeof(bench_thread));
+	latencies = (unsigned long long*)calloc(config.calls, sizeof(unsigned long long));
+
+	if (NULL == threads || NULL == latencies) {
+		free(threads);
+		free(latencies);
+		return ACCL_GENERIC_ERROR;
+	}
+
+	pthread_barrier_init(&start_barrier, NULL, config.threads + 1);
+
+	for (i = 0; i < config.threads; i++) {
+		threads[i].api = api;
+		threads[i].calls = config.calls / config.threads + (i < config.calls % config.threads ? 1 : 0);
+		threads[i].latencies = latencies + offset;
+		offset += threads[i].calls;
+
+		if (NULL != api->setup && ACCL_SUCCESS != api->setup(&threads[i])) {
+			fprintf(stderr, "%-18s setup failed\n", api->name);
+			exit(EXIT_FAILURE);
+		}
+
+		pthread_create(&threads[i].thread, NULL, bench_worker, &threads[i]);
+	}
+
+	// every thread is warm: measure
+	pthread_barrier_wait(&start_barrier);
+
+	allocations_before = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+	bytes_before = __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED);
+	started = bench_now();
+
+	pthread_barrier_wait(&start_barrier);
+
+	elapsed = bench_now() - started;
+	allocations_after = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+	bytes_after = __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED);
+
+	for (i = 0; i < config.threads; i++) {
+		pthread_join(threads[i].thread, NULL);
+
+		if (NULL != api->teardown)
+			api->teardown(&threads[i]);
+
+		errors += threads[i].errors;
+	}
+
+	pthread_barrier_destroy(&start_barrier);
+
+	qsort(latencies, config.calls, sizeof(unsigned long long), bench_compare);
+
+	printf("%-18s %8u calls %6u errors %10.1f calls/s   p50 %9.1f us   p99 %9.1f us   p999 %9.1f us %7.2f allocs/call %10.1f bytes/call\n",
+		api->name, config.calls, errors,
+		config.calls / (elapsed / 1e9),
+		bench_percentile(latencies, config.calls, 0.5),
+		bench_percentile(latencies, config.calls, 0.99),
+		bench_percentile(latencies, config.calls, 0.999),
+		(double)(allocations_after - allocations_before) / config.calls,
+		(double)(bytes_after - bytes_before) / config.calls);
+
+	free(latencies);
+	free(threads);
+
+	return ACCL_SUCCESS;
+}
+
+static void usage(const char* name) {
+	unsigned int i;
+
+	fprintf(stderr,
+		"usage: %s [-n calls] [-t threads] [-s payload_size] [-d depth] [-w warmup] [-T technique_id] [api ...]\n"
+		"\t-n  measured calls per API (default 10000)\n"
+		"\t-t  calling threads (default 1)\n"
+		"\t-s  payload size in bytes (default 256)\n"
+		"\t-d  async requests in flight per thread and batch size (default 16)\n"
+		"\t-w  unmeasured calls per thread before each API (default 16)\n"
+		"\t-T  technique id (default ACCL_TID_TEST)\n"
+		"apis:",
+		name);
+
+	for (i = 0; i < BENCH_API_COUNT; i++)
+		fprintf(stderr, " %s", apis[i].name);
+
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv) {
+	int option;
+	int i;
+	unsigned int a;
+
+	while (-1 != (option = getopt(argc, argv, "n:t:s:d:w:T:h"))) {
+		switch (option) {
+			case 'n':
+				config.calls = (unsigned int)atoi(optarg);
+				break;
+			case 't':
+				config.threads = (unsigned int)atoi(optarg);
+				break;
+			case 's':
+				config.payload_size = (unsigned int)atoi(optarg);
+				break;
+			case 'd':
+				config.depth = (unsigned int)atoi(optarg);
+				break;
+			case 'w':
+				config.warmup = (unsigned int)atoi(optarg);
+				break;
+			case 'T':
+				config.technique_id = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (0 == config.calls || 0 == config.threads || 0 == config.depth || config.threads > config.calls) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	payload = (char*)malloc(config.payload_size + 1);
+
+	if (NULL == payload)
+		return EXIT_FAILURE;
+
+	memset(payload, 'p', config.payload_size);
+
+	for (a = 0; a < BENCH_API_COUNT; a++) {
+		// no API named on the command line: run them all
+		for (i = optind; i < argc && 0 != strcmp(argv[i], apis[a].name); i++)
+			;
+
+		if (optind == argc || i < argc)
+			bench_run(&apis[a]);
+	}
+
+	free(payload);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,894 @@
+/* This research is supported by the European Union Seventh Framework Programme (FP7/2007-2013), project ASPIRE (Advanced  Software Protection: Integration, Research, and Exploitation), under grant agreement no. 609734; on-line at https://aspire-fp7.eu/. */
+
+/*
+	ASPIRE Client-side Communication Logic
+
+	mock_portal.c - local stand-in of the ASPIRE Portal for benchmarking
+
+	HTTP:       POST /exchange/<tid>/<appid> answers the payload (or a fixed
+	            size body), POST /send/<tid>/<appid> answers an empty body
+	WebSockets: 'accl-communication-protocol' on every port returned by
+	            acclGetWebSocketPort, exchanges (first byte 1) are echoed,
+	            tagged exchanges (first byte 2) with their request id,
+	            batches (first byte 3) are unpacked, deflate offers
+	            (first byte 4) are accepted and deflated messages (first
+	            byte 5) inflated, answers are never deflated
+
+	latency, jitter, response size and error rate are injected on both
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <zlib.h>
+#include <accl.h>
+
+#define MOCK_HEADER_SIZE		16384
+#define MOCK_MAX_BODY_SIZE		(ACCL_MAX_BUFFER_SIZE * 4)
+
+/* injected behaviour (command line) */
+typedef struct mock_config {
+	int http_port;
+	int websockets;				/* serve the WebSocket ports too */
+	unsigned int latency;		/* milliseconds added to every response */
+	unsigned int jitter;		/* +/- milliseconds around latency */
+	long response_size;			/* -1: echo the payload */
+	double error_rate;			/* fraction of failed requests */
+} mock_config;
+
+static mock_config config = {
+	8088,
+	1,
+	0,
+	0,
+	-1,
+	0.0
+};
+
+static void usage(const char* name) {
+	fprintf(stderr,
+		"usage: %s [-p http_port] [-l latency_ms] [-j jitter_ms] [-s response_size] [-e error_rate] [-W]\n"
+		"\t-p  HTTP port (default 8088)\n"
+		"\t-l  latency injected in every response, milliseconds\n"
+		"\t-j  uniform jitter around the latency, milliseconds\n"
+		"\t-s  response body size in bytes (default: echo the payload)\n"
+		"\t-e  fraction of requests answered with an error, 0..1\n"
+		"\t-W  do not serve the WebSocket ports\n",
+		name);
+}
+
+/*
+	Sleeps for the configured latency +/- jitter, returns non zero when
+	the request has to fail
+*/
+static int mock_inject(unsigned int* seed) {
+	long delay = config.latency;
+
+	if (config.jitter > 0)
+		delay += (long)(rand_r(seed) % (2 * config.jitter + 1)) - (long)config.jitter;
+
+	if (delay > 0)
+		usleep((useconds_t)delay * 1000);
+
+	return config.error_rate > 0.0 && (double)rand_r(seed) / RAND_MAX < config.error_rate;
+}
+
+/*
+	Response body: the payload itself or response_size bytes
+*/
+static char* mock_body(const char* payload, size_t payload_size, size_t* body_size) {
+	char* body;
+
+	if (config.response_size < 0) {
+		*body_size = payload_size;
+		body = (char*)malloc(payload_size + 1);
+
+		if (NULL != body)
+			memcpy(body, payload, payload_size);
+	} else {
+		*body_size = (size_t)config.response_size;
+		body = (char*)malloc(*body_size + 1);
+
+		if (NULL != body)
+			memset(body, 'x', *body_size);
+	}
+
+	return body;
+}
+
+/*
+	HTTP endpoint
+*/
+typedef struct mock_connection {
+	int fd;
+	char* buffer;				/* received, not yet consumed bytes */
+	size_t size;
+	size_t capacity;
+} mock_connection;
+
+static int mock_fill(mock_connection* connection) {
+	ssize_t received;
+
+	if (connection->size == connection->capacity) {
+		char* grown;
+
+		if (connection->capacity >= MOCK_MAX_BODY_SIZE)
+			return -1;
+
+		grown = (char*)realloc(connection->buffer, connection->capacity * 2);
+
+		if (NULL == grown)
+			return -1;
+
+		connection->buffer = grown;
+		connection->capacity *= 2;
+	}
+
+	received = recv(connection->fd, connection->buffer + connection->size,
+		connection->capacity - connection->size, 0);
+
+	if (received <= 0)
+		return -1;
+
+	connection->size += (size_t)received;
+
+	return 0;
+}
+
+static void mock_consume(mock_connection* connection, size_t length) {
+	memmove(connection->buffer, connection->buffer + length, connection->size - length);
+	connection->size -= length;
+}
+
+static int mock_write(int fd, const char* data, size_t length) {
+	ssize_t sent;
+
+	while (length > 0) {
+		sent = send(fd, data, length, MSG_NOSIGNAL);
+
+		if (sent <= 0)
+			return -1;
+
+		data += sent;
+		length -= (size_t)sent;
+	}
+
+	return 0;
+}
+
+static const char* mock_header(const char* headers, const char* name) {
+	const char* line = strstr(headers, "\r\n");
+	size_t length = strlen(name);
+
+	while (NULL != line && 0 != strncmp(line, "\r\n\r\n", 4)) {
+		line += 2;
+
+		if (0 == strncasecmp(line, name, length) && ':' == line[length]) {
+			line += length + 1;
+
+			while (' ' == *line)
+				line++;
+
+			return line;
+		}
+
+		line = strstr(line, "\r\n");
+	}
+
+	return NULL;
+}
+
+/*
+	Reads a body of known length or a chunked one, returns its size or -1
+*/
+static long mock_read_body(mock_connection* connection, char** body, long content_length, int chunked) {
+	char* decoded = NULL;
+	size_t decoded_size = 0;
+	char* line_end;
+	unsigned long chunk;
+
+	if (!chunked) {
+		if (content_length > MOCK_MAX_BODY_SIZE)
+			return -1;
+
+		while (connection->size < (size_t)content_length) {
+			if (0 != mock_fill(connection))
+				return -1;
+		}
+
+		*body = (char*)malloc((size_t)content_length + 1);
+
+		if (NULL == *body)
+			return -1;
+
+		memcpy(*body, connection->buffer, (size_t)content_length);
+		mock_consume(connection, (size_t)content_length);
+
+		return content_length;
+	}
+
+	for (;;) {
+		while (NULL == (line_end = (char*)memmem(connection->buffer, connection->size, "\r\n", 2))) {
+			if (0 != mock_fill(connection))
+				goto error;
+		}
+
+		chunk = strtoul(connection->buffer, NULL, 16);
+		mock_consume(connection, (size_t)(line_end - connection->buffer) + 2);
+
+		if (decoded_size + chunk > MOCK_MAX_BODY_SIZE)
+			goto error;
+
+		while (connection->size < chunk + 2) {
+			if (0 != mock_fill(connection))
+				goto error;
+		}
+
+		if (0 == chunk) {
+			// no trailers are sent by ACCL
+			mock_consume(connection, 2);
+			break;
+		}
+
+		char* grown = (char*)realloc(decoded, decoded_size + chunk + 1);
+
+		if (NULL == grown)
+			goto error;
+
+		decoded = grown;
+		memcpy(decoded + decoded_size, connection->buffer, chunk);
+		decoded_size += chunk;
+		mock_consume(connection, chunk + 2);
+	}
+
+	*body = (NULL != decoded) ? decoded : (char*)malloc(1);
+
+	return (long)decoded_size;
+
+error:
+	free(decoded);
+	return -1;
+}
+
+/*
+	gzip request bodies (acclSetCompression) are inflated in place
+*/
+static long mock_inflate(char** body, long size) {
+	z_stream stream;
+	char* inflated = NULL;
+	size_t capacity = (size_t)size * 4 + 1024;
+	int result;
+
+	memset(&stream, 0, sizeof(stream));
+
+	if (Z_OK != inflateInit2(&stream, 15 + 32))
+		return -1;
+
+	stream.next_in = (Bytef*)*body;
+	stream.avail_in = (uInt)size;
+
+	do {
+		char* grown = (char*)realloc(inflated, capacity);
+
+		if (NULL == grown) {
+			result = Z_MEM_ERROR;
+			break;
+		}
+
+		inflated = grown;
+		stream.next_out = (Bytef*)inflated + stream.total_out;
+		stream.avail_out = (uInt)(capacity - stream.total_out);
+
+		result = inflate(&stream, Z_NO_FLUSH);
+		capacity *= 2;
+	} while (Z_OK == result || (Z_BUF_ERROR == result && 0 == stream.avail_out));
+
+	inflateEnd(&stream);
+
+	if (Z_STREAM_END != result) {
+		free(inflated);
+		return -1;
+	}
+
+	free(*body);
+	*body = inflated;
+
+	return (long)stream.total_out;
+}
+
+static void* mock_http_connection(void* arg) {
+	mock_connection connection;
+	unsigned int seed = (unsigned int)(size_t)arg ^ (unsigned int)time(NULL);
+	char response[256];
+	char method[16];
+	char path[1024];
+	const char* route;
+	const char* value;
+	char* headers_end;
+	char* body;
+	char* reply;
+	size_t reply_size;
+	size_t headers_size;
+	long body_size;
+	long content_length;
+	int chunked, gzipped, keep_alive, status;
+
+	connection.fd = (int)(size_t)arg;
+	connection.size = 0;
+	connection.capacity = MOCK_HEADER_SIZE;
+	connection.buffer = (char*)malloc(connection.capacity);
+
+	while (NULL != connection.buffer) {
+		// request line and headers
+		while (NULL == (headers_end = (char*)memmem(connection.buffer, connection.size, "\r\n\r\n", 4))) {
+			if (connection.size >= MOCK_HEADER_SIZE || 0 != mock_fill(&connection))
+				goto close;
+		}
+
+		headers_end[2] = '\0';
+		headers_size = (size_t)(headers_end - connection.buffer) + 4;
+
+		if (2 != sscanf(connection.buffer, "%15s %1023s", method, path))
+			goto close;
+
+		// the endpoint ends with a slash: ACCL asks for //exchange/...
+		for (route = path; '/' == route[0] && '/' == route[1]; route++)
+			;
+
+		value = mock_header(connection.buffer, "Content-Length");
+		content_length = (NULL != value) ? atol(value) : 0;
+
+		value = mock_header(connection.buffer, "Transfer-Encoding");
+		chunked = (NULL != value && 0 == strncasecmp(value, "chunked", 7));
+
+		value = mock_header(connection.buffer, "Content-Encoding");
+		gzipped = (NULL != value && 0 == strncasecmp(value, "gzip", 4));
+
+		value = mock_header(connection.buffer, "Connection");
+		keep_alive = (NULL == value || 0 != strncasecmp(value, "close", 5));
+
+		value = mock_header(connection.buffer, "Expect");
+
+		if (NULL != value && 0 == strncasecmp(value, "100-continue", 12)
+			&& 0 != mock_write(connection.fd, "HTTP/1.1 100 Continue\r\n\r\n", 25))
+			goto close;
+
+		mock_consume(&connection, headers_size);
+
+		// payload
+		body = NULL;
+		body_size = mock_read_body(&connection, &body, content_length, chunked);
+
+		if (body_size >= 0 && gzipped)
+			body_size = mock_inflate(&body, body_size);
+
+		if (body_size < 0) {
+			free(body);
+			goto close;
+		}
+
+		// response
+		reply = NULL;
+		reply_size = 0;
+		status = 200;
+
+		if (mock_inject(&seed))
+			status = 500;
+		else if (0 == strncmp(route, "/exchange/", 10))
+			reply = mock_body(body, (size_t)body_size, &reply_size);
+		else if (0 != strncmp(route, "/send/", 6))
+			status = 404;
+
+		free(body);
+
+		snprintf(response, sizeof(response),
+			"HTTP/1.1 %d %s\r\nContent-Type: application/octet-stream\r\nContent-Length: %lu\r\n%s\r\n",
+			status, (200 == status) ? "OK" : "Error", (unsigned long)reply_size,
+			keep_alive ? "" : "Connection: close\r\n");
+
+		if (0 != mock_write(connection.fd, response, strlen(response))
+			|| (reply_size > 0 && 0 != mock_write(connection.fd, reply, reply_size))) {
+			free(reply);
+			goto close;
+		}
+
+		free(reply);
+
+		if (!keep_alive)
+			break;
+	}
+
+close:
+	free(connection.buffer);
+	close(connection.fd);
+
+	return NULL;
+}
+
+static void* mock_http_server(void* arg) {
+	struct sockaddr_in address;
+	pthread_t thread;
+	int listener, fd;
+	int on = 1;
+
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (listener < 0) {
+		perror("socket");
+		exit(EXIT_FAILURE);
+	}
+
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons((unsigned short)config.http_port);
+
+	if (0 != bind(listener, (struct sockaddr*)&address, sizeof(address)) || 0 != listen(listener, 1024)) {
+		perror("bind");
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(stderr, "mock_portal: HTTP on port %d\n", config.http_port);
+
+	for (;;) {
+		fd = accept(listener, NULL, NULL);
+
+		if (fd < 0) {
+			if (EINTR == errno)
+				continue;
+
+			perror("accept");
+			break;
+		}
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+		// one thread per (keep-alive) connection
+		if (0 != pthread_create(&thread, NULL, mock_http_connection, (void*)(size_t)fd))
+			close(fd);
+		else
+			pthread_detach(thread);
+	}
+
+	return arg;
+}
+
+#ifndef WITHOUT_WEBSOCKETS
+
+/* port of each technique channel, see accl.c */
+extern int acclGetWebSocketPort(int technique_id);
+
+/* every technique the ACCL can open a channel for */
+static const int ws_techniques[] = {
+	ACCL_TID_CODE_SPLITTING, ACCL_TID_CODE_MOBILITY, ACCL_TID_DATA_MOBILITY, ACCL_TID_WBS,
+	ACCL_TID_MTC_CRYPTO_SERVER, ACCL_TID_DIVERSIFIED_CRYPTO, ACCL_TID_CG_HASH_RANDOMIZATION,
+	ACCL_TID_CG_HASH_VERIFICATION, ACCL_TID_CFGT_REMOVE_VERIFIER, ACCL_TID_AC_DECISION_LOGIC,
+	ACCL_TID_AC_STATUS_LOGIC, ACCL_TID_RA_REACTION_MANAGER, ACCL_TID_RA_VERIFIER, ACCL_RENEWABILITY,
+	ACCL_RA_ATTESTATOR_0, ACCL_RA_ATTESTATOR_1, ACCL_RA_ATTESTATOR_2, ACCL_RA_ATTESTATOR_3,
+	ACCL_RA_ATTESTATOR_4, ACCL_RA_ATTESTATOR_5, ACCL_RA_ATTESTATOR_6, ACCL_RA_ATTESTATOR_7,
+	ACCL_RA_ATTESTATOR_8, ACCL_RA_ATTESTATOR_9, ACCL_TID_TEST
+};
+
+/* pre-padded outbound message */
+struct mock_ws_reply {
+	struct mock_ws_reply* next;
+	size_t size;
+	size_t sent;				/* written in ACCL_MAX_WS_BUFFER_SIZE fragments */
+	unsigned char buffer[];
+};
+
+/* per connection state */
+struct mock_ws_session {
+	char* message;				/* inbound message being reassembled */
+	size_t message_size;
+	struct mock_ws_reply* replies;	/* outbound queue, several exchanges may be in flight */
+	struct mock_ws_reply** tail;
+	unsigned int seed;
+	int deflate;				/* offer accepted, inflater initialized */
+	z_stream inflater;			/* client messages of the connection */
+};
+
+/* queues an outbound message: echoed header bytes, then the body */
+static int mock_ws_queue(struct mock_ws_session* session, const char* header, size_t header_size, const char* body, size_t body_size) {
+	struct mock_ws_reply* reply;
+
+	reply = (struct mock_ws_reply*)malloc(sizeof(struct mock_ws_reply) +
+		LWS_SEND_BUFFER_PRE_PADDING + header_size + body_size + LWS_SEND_BUFFER_POST_PADDING);
+
+	if (NULL == reply)
+		return -1;
+
+	memcpy(reply->buffer + LWS_SEND_BUFFER_PRE_PADDING, header, header_size);
+	memcpy(reply->buffer + LWS_SEND_BUFFER_PRE_PADDING + header_size, body, body_size);
+	reply->size = header_size + body_size;
+	reply->sent = 0;
+	reply->next = NULL;
+
+	*session->tail = reply;
+	session->tail = &reply->next;
+
+	return 0;
+}
+
+/*
+	Queues the answer of an exchange, the first header bytes of the
+	request are sent back in front of the body
+*/
+static int mock_ws_reply(struct mock_ws_session* session, const char* message, size_t message_size, size_t header, size_t echoed) {
+	char* body;
+	size_t body_size;
+	int result;
+
+	body = mock_body(message + header, message_size - header, &body_size);
+
+	if (NULL == body)
+		return -1;
+
+	result = mock_ws_queue(session, message, echoed, body, body_size);
+	free(body);
+
+	return result;
+}
+
+/*
+	Inflates an ACCL_WS_DEFLATED message with the connection stream, the
+	sync flush trailer the client left out is added back
+*/
+static char* mock_ws_inflate(struct mock_ws_session* session, const char* message, size_t message_size, size_t* size) {
+	static const unsigned char trailer[4] = { 0x00, 0x00, 0xff, 0xff };
+	z_stream* stream = &session->inflater;
+	size_t capacity = message_size * 4 + 1024;
+	char* inflated = NULL;
+	char* grown;
+	int result = Z_OK;
+	int i;
+
+	*size = 0;
+
+	for (i = 0; i < 2; i++) {
+		stream->next_in = (Bytef*)((0 == i) ? message + 1 : (const char*)trailer);
+		stream->avail_in = (uInt)((0 == i) ? message_size - 1 : sizeof(trailer));
+
+		do {
+			if (NULL == inflated || *size == capacity) {
+				capacity = (NULL == inflated) ? capacity : capacity * 2;
+
+				if (capacity > MOCK_MAX_BODY_SIZE || NULL == (grown = (char*)realloc(inflated, capacity))) {
+					free(inflated);
+					return NULL;
+				}
+
+				inflated = grown;
+			}
+
+			stream->next_out = (Bytef*)inflated + *size;
+			stream->avail_out = (uInt)(capacity - *size);
+
+			result = inflate(stream, Z_SYNC_FLUSH);
+			*size = capacity - stream->avail_out;
+
+			if (Z_STREAM_END == result)
+				result = inflateReset(stream);
+		} while ((Z_OK == result || Z_BUF_ERROR == result) && (0 != stream->avail_in || 0 == stream->avail_out));
+
+		if (Z_OK != result && Z_BUF_ERROR != result) {
+			free(inflated);
+			return NULL;
+		}
+	}
+
+	return inflated;
+}
+
+static void mock_ws_release(struct mock_ws_session* session) {
+	struct mock_ws_reply* reply;
+
+	while (NULL != (reply = session->replies)) {
+		session->replies = reply->next;
+		free(reply);
+	}
+
+	if (session->deflate)
+		inflateEnd(&session->inflater);
+
+	free(session->message);
+	memset(session, 0, sizeof(*session));
+	session->tail = &session->replies;
+}
+
+/*
+	Handles one client message, unpacking the coalesced ones
+*/
+static int mock_ws_message(struct mock_ws_session* session, const char* message, size_t message_size) {
+	const unsigned char* size = (const unsigned char*)message;
+	size_t offset, length;
+	char* inflated;
+	char accept[2];
+	int result;
+
+	if (0 == message_size)
+		return 0;
+
+	// the first byte tells sends from exchanges (see ACCL_WS_SEND)
+
+	switch (message[0]) {
+		case ACCL_WS_EXCHANGE:
+			return mock_ws_reply(session, message, message_size, 1, 0);
+
+		case ACCL_WS_TAGGED_EXCHANGE:
+			if (message_size < ACCL_WS_TAG_SIZE)
+				return -1;
+
+			return mock_ws_reply(session, message, message_size, ACCL_WS_TAG_SIZE, ACCL_WS_TAG_SIZE);
+
+		case ACCL_WS_BATCH:
+			for (offset = 1; offset < message_size; offset += ACCL_WS_BATCH_HEADER + length) {
+				if (offset + ACCL_WS_BATCH_HEADER > message_size)
+					return -1;
+
+				length = ((size_t)size[offset] << 24) | ((size_t)size[offset + 1] << 16) |
+					((size_t)size[offset + 2] << 8) | size[offset + 3];
+
+				if (offset + ACCL_WS_BATCH_HEADER + length > message_size ||
+						0 != mock_ws_message(session, message + offset + ACCL_WS_BATCH_HEADER, length))
+					return -1;
+			}
+
+			return 0;
+
+		case ACCL_WS_DEFLATE_OFFER:
+			if (2 != message_size || session->deflate)
+				return -1;
+
+			memset(&session->inflater, 0, sizeof(session->inflater));
+
+			if (Z_OK != inflateInit2(&session->inflater, -(int)size[1]))
+				return -1;
+
+			session->deflate = 1;
+
+			// the window bits answers are deflated with: none are
+			accept[0] = ACCL_WS_DEFLATE_OFFER;
+			accept[1] = message[1];
+
+			return mock_ws_queue(session, accept, sizeof(accept), "", 0);
+
+		case ACCL_WS_DEFLATED:
+			if (!session->deflate ||
+					NULL == (inflated = mock_ws_inflate(session, message, message_size, &length)))
+				return -1;
+
+			result = mock_ws_message(session, inflated, length);
+			free(inflated);
+
+			return result;
+
+		default:
+			return 0;
+	}
+}
+
+static int mock_ws_callback(struct libwebsocket_context* context, struct libwebsocket* wsi,
+	enum libwebsocket_callback_reasons reason, void* user, void* in, size_t len) {
+
+	struct mock_ws_session* session = (struct mock_ws_session*)user;
+	struct mock_ws_reply* reply;
+	unsigned char post_padding[LWS_SEND_BUFFER_POST_PADDING];
+	size_t fragment;
+	int write_protocol;
+	char* grown;
+	int queued;
+
+	switch (reason) {
+		case LWS_CALLBACK_ESTABLISHED:
+			memset(session, 0, sizeof(*session));
+			session->tail = &session->replies;
+			session->seed = (unsigned int)(size_t)wsi;
+			break;
+
+		case LWS_CALLBACK_RECEIVE:
+			grown = (char*)realloc(session->message, session->message_size + len);
+
+			if (NULL == grown)
+				return -1;
+
+			session->message = grown;
+			memcpy(session->message + session->message_size, in, len);
+			session->message_size += len;
+
+			if (libwebsockets_remaining_packet_payload(wsi) > 0 || !libwebsocket_is_final_fragment(wsi))
+				break;
+
+			if (mock_inject(&session->seed)) {
+				// failures drop the channel
+				return -1;
+			}
+
+			queued = (NULL != session->replies);
+
+			if (0 != mock_ws_message(session, session->message, session->message_size))
+				return -1;
+
+			if (!queued && NULL != session->replies)
+				libwebsocket_callback_on_writable(context, wsi);
+
+			session->message_size = 0;
+			break;
+
+		case LWS_CALLBACK_SERVER_WRITEABLE:
+			if (NULL == (reply = session->replies))
+				break;
+
+			fragment = MIN(reply->size - reply->sent, (size_t)ACCL_MAX_WS_BUFFER_SIZE);
+			write_protocol = (0 == reply->sent) ? LWS_WRITE_BINARY : LWS_WRITE_CONTINUATION;
+
+			if (reply->sent + fragment < reply->size)
+				write_protocol |= LWS_WRITE_NO_FIN;
+
+			// the post padding of an inner fragment is the start of the next one
+			memcpy(post_padding, reply->buffer + LWS_SEND_BUFFER_PRE_PADDING + reply->sent + fragment, LWS_SEND_BUFFER_POST_PADDING);
+
+			if (libwebsocket_write(wsi, reply->buffer + LWS_SEND_BUFFER_PRE_PADDING + reply->sent,
+					fragment, (enum libwebsocket_write_protocol)write_protocol) < (int)fragment)
+				return -1;
+
+			memcpy(reply->buffer + LWS_SEND_BUFFER_PRE_PADDING + reply->sent + fragment, post_padding, LWS_SEND_BUFFER_POST_PADDING);
+			reply->sent += fragment;
+
+			if (reply->sent < reply->size) {
+				libwebsocket_callback_on_writable(context, wsi);
+				break;
+			}
+
+			session->replies = reply->next;
+			if (NULL == session->replies)
+				session->tail = &session->replies;
+			free(reply);
+
+			// one message per writeable callback
+			if (NULL != session->replies)
+				libwebsocket_callback_on_writable(context, wsi);
+			break;
+
+		case LWS_CALLBACK_CLOSED:
+			mock_ws_release(session);
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+static struct libwebsocket_protocols mock_ws_protocols[] = {
+	{
+		"accl-communication-protocol",
+		mock_ws_callback,
+		sizeof(struct mock_ws_session),
+	},
+	{
+		/* end of list */
+		NULL,
+		NULL,
+		0
+	}
+};
+
+static void* mock_ws_server(void* arg) {
+	struct libwebsocket_context* context = (struct libwebsocket_context*)arg;
+
+	for (;;)
+		libwebsocket_service(context, 50);
+
+	return NULL;
+}
+
+/*
+	One listening context (and service thread) per distinct port
+*/
+static void mock_ws_start(void) {
+	struct lws_context_creation_info info;
+	struct libwebsocket_context* context;
+	struct libwebsocket_protocols* context_protocols;
+	pthread_t thread;
+	int ports[sizeof(ws_techniques) / sizeof(ws_techniques[0])];
+	int port_count = 0;
+	int port, i, j;
+
+	for (i = 0; i < (int)(sizeof(ws_techniques) / sizeof(ws_techniques[0])); i++) {
+		port = acclGetWebSocketPort(ws_techniques[i]);
+
+		for (j = 0; j < port_count && ports[j] != port; j++)
+			;
+
+		if (j < port_count)
+			continue;
+
+		ports[port_count++] = port;
+
+		// contexts do not share protocol arrays (see acclWebSocketInit)
+		context_protocols = (struct libwebsocket_protocols*)malloc(sizeof(mock_ws_protocols));
+		memcpy(context_protocols, mock_ws_protocols, sizeof(mock_ws_protocols));
+
+		memset(&info, 0, sizeof(info));
+		info.port = port;
+		info.protocols = context_protocols;
+		info.gid = -1;
+		info.uid = -1;
+
+		context = libwebsocket_create_context(&info);
+
+		if (NULL == context) {
+			fprintf(stderr, "mock_portal: WebSocket port %d unavailable\n", port);
+			continue;
+		}
+
+		if (0 != pthread_create(&thread, NULL, mock_ws_server, context)) {
+			libwebsocket_context_destroy(context);
+			continue;
+		}
+
+		pthread_detach(thread);
+
+		fprintf(stderr, "mock_portal: WebSocket on port %d\n", port);
+	}
+}
+
+#endif /* WITHOUT_WEBSOCKETS */
+
+int main(int argc, char** argv) {
+	int option;
+
+	while (-1 != (option = getopt(argc, argv, "p:l:j:s:e:Wh"))) {
+		switch (option) {
+			case 'p':
+				config.http_port = atoi(optarg);
+				break;
+			case 'l':
+				config.latency = (unsigned int)atoi(optarg);
+				break;
+			case 'j':
+				config.jitter = (unsigned int)atoi(optarg);
+				break;
+			case 's':
+				config.response_size = atol(optarg);
+				break;
+			case 'e':
+				config.error_rate = atof(optarg);
+				break;
+			case 'W':
+				config.websockets = 0;
+				break;
+			default:
+				usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+#ifndef WITHOUT_WEBSOCKETS
+	if (config.websockets) {
+		lws_set_log_level(0, NULL);
+		mock_ws_start();
+	}
+#endif
+
+	mock_http_server(NULL);
+
+	return EXIT_FAILURE;
+}
@@ -6,9 +6,20 @@
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <curl/curl.h>
+#include <zlib.h>
 #include <accl.h>
 
 /*
@@ -17,42 +28,56 @@
 	see also accl.h for a brief description and parameters explanation
 */
 
-static char endpoint[1024] = "X";
-static char application_id[1024] = "X";
+/*
+	Reads ACCL_FILE_PATH/name whole (it may list several portals), the
+	compile time default is used when the file is missing or empty
+*/
+static void acclConfigRead(const char* name, const char* fallback, char* value, const size_t size) {
+	char path[1024];
+	FILE* file;
+	size_t length = 0;
 
-static void GetAspirePortalEndpoint(){
-  if (endpoint[0]!='X') return;
-  FILE * endpointfile = fopen(ACCL_FILE_PATH "/ASPIREendpoint","r");
-  if (!endpointfile)
-    {
-      strncpy(endpoint,ACCL_ASPIRE_PORTAL_ENDPOINT,1024);
-    }
-  else
-  {
-    fscanf(endpointfile,"%s",endpoint);
-    fclose(endpointfile);
-  }
+	snprintf(path, sizeof(path), "%s/%s", ACCL_FILE_PATH, name);
 
-#ifndef NDEBUG
-  acclLOG("initialize_endpoint",
-	  "%s",
-	  ACCL_LOG_LEVEL_DEBUG,
-	  endpoint);
-#endif
+	file = fopen(path, "r");
 
-  return;
-}
+	if (file) {
+		length = fread(value, 1, size - 1, file);
+		fclose(file);
+	}
 
-static char* GetAspireApplicationId() {
-	if (application_id[0] == 'X') {
-		char* app_start_address = (char*)&application_id;
+	value[length] = '\0';
 
-		getApplicationId(&app_start_address);
+	if (0 == length || strspn(value, " \t\r\n,") == length) {
+		strncpy(value, fallback, size - 1);
+		value[size - 1] = '\0';
 	}
+}
 
+/*
+	Resolves the ASPIRE Portal endpoints: ACCL_FILE_PATH/ASPIREendpoint, if
+	present, overrides the compile time default
+*/
+static void acclConfigEndpoint(char* endpoint, const size_t size) {
+	acclConfigRead("ASPIREendpoint", ACCL_ASPIRE_PORTAL_ENDPOINT, endpoint, size);
+
+#ifndef NDEBUG
+	acclLOG("initialize_endpoint",
+		"%s",
+		ACCL_LOG_LEVEL_DEBUG,
+		endpoint);
+#endif
+}
 
-	return application_id;
+#ifndef WITHOUT_WEBSOCKETS
+/*
+	Resolves the WebSockets hosts: ACCL_FILE_PATH/ASPIREhost, if present,
+	overrides the compile time default
+*/
+static void acclConfigWebSocketHost(char* host, const size_t size) {
+	acclConfigRead("ASPIREhost", ACCL_WS_ASPIRE_PORTAL_HOST, host, size);
 }
+#endif
 
 #ifndef EXTERNAL_GET_APPLICATION_ID
 
@@ -65,598 +90,5544 @@ void getApplicationId(char** ptr_to_string_to_be_filled) {
 
 #endif
 
-int acclExchange (
-	const int T_ID,
-	const int payloadBufferSize,
-	const char* pPayloadBuffer,
-	unsigned* returnBufferSize,
-	char** pReturnBuffer) {
+static int global_error = ACCL_SUCCESS;
+static pthread_once_t global_once = PTHREAD_ONCE_INIT;
 
-	CURL *curl;
-  	CURLcode res;
-  	accl_payload_transfer payload;
-  	accl_response response;
-  	struct curl_slist *chunk = NULL;
-  	char aspire_portal_uri[1024];
-  	long http_response_code = 0;
+/*
+	One-time process wide initialization (invoked through pthread_once)
+*/
+static void acclGlobalInit(void) {
+	CURLcode res = curl_global_init(CURL_GLOBAL_DEFAULT);
 
+	if (res != CURLE_OK) {
 #ifndef NDEBUG
-	acclLOG("ACCL", "Exchange API invocation.", ACCL_LOG_LEVEL_INFO);
+		acclLOG("acclGlobalInit",
+			"curl_global_init() failed: %s",
+			ACCL_LOG_LEVEL_ERROR,
+			curl_easy_strerror(res));
 #endif
+		global_error = ACCL_CURL_INITIALIZATION_ERROR;
+	}
+}
 
-	// PARAMETERS SANITY CHECK
+/*
+	ACCL HTTP connection pool
+	cURL easy handles are kept alive between requests and share a single
+	connection, DNS and TLS session cache, so that repeated calls to the
+	ASPIRE Portal reuse already established connections
+*/
+typedef struct accl_http_pool {
+	pthread_mutex_t mutex;						/* protects handles/count */
+	CURL* handles[ACCL_HTTP_POOL_SIZE];			/* idle easy handles */
+	int count;									/* number of idle handles */
+	CURLSH* share;								/* shared connection cache */
+	pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+	int error;									/* initialization outcome */
+} accl_http_pool;
+
+static void acclHttpShareLock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+	accl_http_pool* pool = (accl_http_pool*)userptr;
+
+	pthread_mutex_lock(&pool->share_locks[data]);
+}
 
-	// buffer size check
-	if (payloadBufferSize <= 0){
+static void acclHttpShareUnlock(CURL* handle, curl_lock_data data, void* userptr) {
+	accl_http_pool* pool = (accl_http_pool*)userptr;
 
-#ifndef NDEBUG
-		acclLOG("acclExchange",
-			"payload buffer size not valid (%d bytes specified)",
-			ACCL_LOG_LEVEL_ERROR,
-			payloadBufferSize);
-#endif
+	pthread_mutex_unlock(&pool->share_locks[data]);
+}
 
-		return ACCL_INPUT_BUFFER_ERROR;
-	}
+static void acclHttpPoolInit(accl_http_pool* pool) {
+	int i;
 
-	if (payloadBufferSize > ACCL_MAX_BUFFER_SIZE) {
-#ifndef NDEBUG
-		acclLOG("acclExchange",
-			"payload maximum size is %d bytes, %d bytes provided",
-			ACCL_LOG_LEVEL_ERROR,
-			ACCL_MAX_BUFFER_SIZE,
-			payloadBufferSize);
-#endif
-		return ACCL_INPUT_BUFFER_MAX_SIZE_EXCEEDED;
-	}
+	pool->error = ACCL_SUCCESS;
+	pool->count = 0;
 
-	// technique id check
-	switch (T_ID) {
-	case ACCL_TID_CODE_SPLITTING:
-	case ACCL_TID_CODE_MOBILITY:
-	case ACCL_TID_WBS:
-	case ACCL_TID_MTC_CRYPTO_SERVER:
-	case ACCL_TID_CG_HASH_RANDOMIZATION:
-	case ACCL_TID_CG_HASH_VERIFICATION:
-	case ACCL_TID_CFGT_REMOVE_VERIFIER:
-	case ACCL_TID_AC_DECISION_LOGIC:
-	case ACCL_TID_AC_STATUS_LOGIC:
-	case ACCL_TID_RA_REACTION_MANAGER:
-	case ACCL_TID_RA_VERIFIER:
-	case ACCL_TID_TEST:
-		break;
-	default:
-#ifndef NDEBUG
-		acclLOG("acclExchange",
-			"unknown technique id: %d",
-			ACCL_LOG_LEVEL_ERROR,
-			T_ID);
-#endif
-		return ACCL_UNKNOWN_TECHNIQUE_ID;
+	pthread_mutex_init(&pool->mutex, NULL);
+
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		pthread_mutex_init(&pool->share_locks[i], NULL);
+
+	pthread_once(&global_once, acclGlobalInit);
+
+	if (global_error != ACCL_SUCCESS) {
+		pool->share = NULL;
+		pool->error = global_error;
+		return;
 	}
 
-	// cURL initialization
-	res = curl_global_init(CURL_GLOBAL_DEFAULT);
+	pool->share = curl_share_init();
 
-	// Check for errors
-	if(res != CURLE_OK) {
-#ifndef NDEBUG
-		acclLOG("acclExchange",
-			"curl_global_init() failed: %s",
-			ACCL_LOG_LEVEL_ERROR,
-			curl_easy_strerror(res));
-#endif
-		return ACCL_CURL_INITIALIZATION_ERROR;
+	if (NULL == pool->share) {
+		pool->error = ACCL_CURL_INITIALIZATION_ERROR;
+		return;
 	}
 
-	GetAspirePortalEndpoint();
+	curl_share_setopt(pool->share, CURLSHOPT_LOCKFUNC, acclHttpShareLock);
+	curl_share_setopt(pool->share, CURLSHOPT_UNLOCKFUNC, acclHttpShareUnlock);
+	curl_share_setopt(pool->share, CURLSHOPT_USERDATA, pool);
+	curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+	curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
 
-	// requests to ASPIRE Portal include 
-	// 	- endpoint (ASPIRE Portal URL)
-	//	- request type (exchange | send)
-	//	- technique ID
-	//	- application ID
-	sprintf(aspire_portal_uri, "%s/exchange/%d/%s", endpoint, T_ID, GetAspireApplicationId());
+/*
+	Closes the idle handles and their connections
+*/
+static void acclHttpPoolDestroy(accl_http_pool* pool) {
+	int i;
 
-	curl = curl_easy_init();
+	while (pool->count > 0)
+		curl_easy_cleanup(pool->handles[--pool->count]);
 
-	if (curl) {
-		// payload structure initialization
-		payload.technique_id = T_ID;
-		payload.application_id = GetAspireApplicationId();
-		payload.payload_size = payloadBufferSize;
-		payload.payload_buffer = (char*)pPayloadBuffer;
-		payload.transmit_offset = 0;
-		payload.error = ACCL_SUCCESS;
+	if (NULL != pool->share)
+		curl_share_cleanup(pool->share);
 
-		// response structure initialization
-		response.output_buffer_size = 0;
-		response.output_buffer = 0;
-		response.error = ACCL_SUCCESS;
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		pthread_mutex_destroy(&pool->share_locks[i]);
 
-		// first set the Aspire Portal Endpoint
-		curl_easy_setopt(curl, CURLOPT_URL, aspire_portal_uri);
+	pthread_mutex_destroy(&pool->mutex);
+}
 
-		// data will be POST-ed
-		curl_easy_setopt(curl, CURLOPT_POST, 1L);
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, payload.payload_size);
+/*
+	Takes an idle handle from the pool (or creates a new one)
+*/
+static CURL* acclHttpAcquire(accl_http_pool* pool) {
+	CURL* curl = NULL;
 
-		// follow redirections
-		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-	 	curl_easy_setopt(curl, CURLOPT_POSTREDIR, 3);
+	if (pool->error != ACCL_SUCCESS)
+		return NULL;
 
-   		// data sending callback setup and point to pass it
-		curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_callback);
-		curl_easy_setopt(curl, CURLOPT_READDATA, &payload);
+	pthread_mutex_lock(&pool->mutex);
+	if (pool->count > 0)
+		curl = pool->handles[--pool->count];
+	pthread_mutex_unlock(&pool->mutex);
 
-    	// data receiving callback setup and point to pass it
-    	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+	if (NULL == curl)
+		curl = curl_easy_init();
 
-    	// cURL verbosity for debug purposes
-    	if (ACCL_LOG_LEVEL < ACCL_LOG_LEVEL_DEBUG)
-		    curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+	return curl;
+}
 
-   		// Perform the request, res will get the return code
-   		res = curl_easy_perform(curl);
+/*
+	Gives a handle back to the pool; its connection stays in the shared cache
+*/
+static void acclHttpRelease(accl_http_pool* pool, CURL* curl) {
+	if (NULL == curl)
+		return;
 
-   		curl_slist_free_all(chunk);
+	// drop per-request options, live connections and caches are preserved
+	curl_easy_reset(curl);
 
-   		// Check for errors
-   		if(res != CURLE_OK){
-#ifndef NDEBUG
-			acclLOG("acclExchange",
-				"curl_easy_perform() failed: %s\n",
-				ACCL_LOG_LEVEL_ERROR,
-				curl_easy_strerror(res));
-#endif
-			if (response.error != ACCL_SUCCESS)
-				return response.error;
+	pthread_mutex_lock(&pool->mutex);
+	if (pool->count < ACCL_HTTP_POOL_SIZE) {
+		pool->handles[pool->count++] = curl;
+		curl = NULL;
+	}
+	pthread_mutex_unlock(&pool->mutex);
 
-			return ACCL_GENERIC_ERROR;
-		} else {
+	// pool is full
+	if (NULL != curl)
+		curl_easy_cleanup(curl);
+}
 
-			// verify response code
-			curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE,
-				&http_response_code);
+/*
+	ACCL HTTP request timeouts
+	a stalled ASPIRE Portal must not freeze the protected application:
+	connection setup, whole request and minimum transfer speed are bounded
+*/
+typedef struct accl_timeouts {
+	unsigned int connect;				/* connection setup limit in ms */
+	unsigned int total;					/* whole request limit in ms (0: none) */
+	unsigned int low_speed_limit;		/* minimum bytes/s (0: none) */
+	unsigned int low_speed_time;		/* seconds below low_speed_limit */
+} accl_timeouts;
+
+static void acclTimeoutsInit(accl_timeouts* timeouts) {
+	timeouts->connect = ACCL_CONNECT_TIMEOUT;
+	timeouts->total = ACCL_RESPONSE_TIMEOUT * 1000;
+	timeouts->low_speed_limit = ACCL_LOW_SPEED_LIMIT;
+	timeouts->low_speed_time = ACCL_LOW_SPEED_TIME;
+}
 
-#ifndef NDEBUG
-			acclLOG("ACCL", "Response received from server RETURN CODE: %d.",
-				ACCL_LOG_LEVEL_INFO, http_response_code);
-#endif
+/*
+	Applies the client timeouts, a per-call deadline replaces the total and
+	low speed limits
+*/
+static void acclTimeoutsSetup(CURL* curl, accl_timeouts* timeouts, const unsigned int deadline) {
+	unsigned int total = (deadline > 0) ? deadline : __atomic_load_n(&timeouts->total, __ATOMIC_RELAXED);
+	unsigned int connect = __atomic_load_n(&timeouts->connect, __ATOMIC_RELAXED);
+	unsigned int low_speed_limit = __atomic_load_n(&timeouts->low_speed_limit, __ATOMIC_RELAXED);
 
-			if (http_response_code == 200 && res != CURLE_ABORTED_BY_CALLBACK) {
-			    	// return output buffer
-				*pReturnBuffer = response.output_buffer;
+	// connection setup cannot outlast the request
+	if (total > 0 && (0 == connect || connect > total))
+		connect = total;
 
-				// return output buffer actual size
-				memcpy ((void*)returnBufferSize,
-					(void*)&response.output_buffer_size,
-					sizeof(unsigned int));
-#ifndef NDEBUG
-				acclLOG("ACCL", "%d bytes copied into internal buffer.",
-					ACCL_LOG_LEVEL_INFO, response.output_buffer_size);
-#endif
-			} else {
-#ifndef NDEBUG
-				acclLOG("acclExchange",
-                                	"server error: %s\n",
-                                	ACCL_LOG_LEVEL_ERROR,
-                                	curl_easy_strerror(res));
-#endif
-			     	return ACCL_SERVER_ERROR;
-			}
-		}
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, (long)connect);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)total);
 
-   		// cleanup
-   		curl_easy_cleanup(curl);
+	// an explicit deadline is the only bound of its call; set either way,
+	// pooled handles keep their options
+	if (deadline > 0)
+		low_speed_limit = 0;
 
-   		return ACCL_SUCCESS;
-	} else {
-		return ACCL_CURL_INITIALIZATION_ERROR;
-	}
+	curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, (long)low_speed_limit);
+	curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME,
+		(long)((low_speed_limit > 0) ? __atomic_load_n(&timeouts->low_speed_time, __ATOMIC_RELAXED) : 0));
+
+	// timeouts are signalled without SIGALRM, ACCL runs in arbitrary threads
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
 }
 
 /*
-	ACCL Simple Request Protocol Implementation
-	see D1.04 sections 2.2 and 2.4.1 for documentation and API specification	
-	see also accl.h for a brief description and parameters explanation
+	ACCL HTTP payload compression
+	payloads above the threshold are gzip encoded and compressed responses
+	are accepted; the compression level follows the measured upload
+	throughput, the slower the link the more CPU time is spent saving bytes
 */
-int acclSend (
-        const int T_ID,
-        const int payloadBufferSize,
-        const char* pPayloadBuffer){
+typedef struct accl_compression {
+	int enabled;						/* request/response compression on */
+	unsigned int threshold;				/* minimum payload size to compress */
+	unsigned long throughput;			/* upload EWMA in bytes/s (0: unknown) */
+} accl_compression;
+
+/* compression level by upload throughput (bytes/s) */
+static const struct {
+	unsigned long throughput;
+	int level;
+} compression_levels[] = {
+	{ 256 * 1024,	Z_BEST_COMPRESSION },
+	{ 1024 * 1024,	6 },
+	{ 4096 * 1024,	3 },
+	{ 0,			Z_BEST_SPEED }		/* always last */
+};
 
-	CURL *curl;
-  	CURLcode res;
-  	accl_payload_transfer payload;
-  	struct curl_slist *chunk = NULL;
-  	char aspire_portal_uri[1024];
-  	long http_response_code = 0;
-  	int returnValue = ACCL_SUCCESS;
+static void acclCompressionInit(accl_compression* compression) {
+	compression->enabled = ACCL_COMPRESSION;
+	compression->threshold = ACCL_COMPRESSION_THRESHOLD;
+	compression->throughput = 0;
+}
 
-#ifndef NDEBUG
-	acclLOG("ACCL", "Send API invocation.", ACCL_LOG_LEVEL_INFO);
-#endif
+static int acclCompressionLevel(accl_compression* compression) {
+	unsigned long throughput = __atomic_load_n(&compression->throughput, __ATOMIC_RELAXED);
+	int i;
 
-	// PARAMETERS SANITY CHECK
-	
-	// buffer size check
-	if (payloadBufferSize <= 0){
-#ifndef NDEBUG
-		acclLOG("acclSend", 
-			"payload buffer size not valid (%d bytes specified)", 
-			ACCL_LOG_LEVEL_ERROR,
-			payloadBufferSize);
-#endif
-		return ACCL_INPUT_BUFFER_ERROR;
-	}
+	// nothing measured yet
+	if (0 == throughput)
+		return Z_DEFAULT_COMPRESSION;
 
-	if (payloadBufferSize > ACCL_MAX_BUFFER_SIZE) {
-#ifndef NDEBUG
-		acclLOG("acclSend", 
-			"payload maximum size is %d bytes, %d bytes provided", 
-			ACCL_LOG_LEVEL_ERROR,
-			ACCL_MAX_BUFFER_SIZE,
-			payloadBufferSize);
-#endif
-		return ACCL_INPUT_BUFFER_MAX_SIZE_EXCEEDED;	
-	}
-
-	// technique id check
-	switch (T_ID) {
-	case ACCL_TID_CODE_SPLITTING:
-	case ACCL_TID_CODE_MOBILITY:
-	case ACCL_TID_WBS:
-	case ACCL_TID_MTC_CRYPTO_SERVER:
-	case ACCL_TID_CG_HASH_RANDOMIZATION:
-	case ACCL_TID_CG_HASH_VERIFICATION:
-	case ACCL_TID_CFGT_REMOVE_VERIFIER:
-	case ACCL_TID_AC_DECISION_LOGIC:
-	case ACCL_TID_AC_STATUS_LOGIC:
-	case ACCL_TID_RA_REACTION_MANAGER:
-	case ACCL_TID_RA_VERIFIER:
-	case ACCL_TID_TEST:
-		break;		
-	default:
-#ifndef NDEBUG
-		acclLOG("acclSend", 
-			"unknown technique id: %d", 
-			ACCL_LOG_LEVEL_ERROR,
-			T_ID);
-#endif
-		return ACCL_UNKNOWN_TECHNIQUE_ID;
-	}
-	
-	// cURL initialization
-	res = curl_global_init(CURL_GLOBAL_DEFAULT);
-	
-	// Check for errors
-	if(res != CURLE_OK) {
-#ifndef NDEBUG
-		acclLOG("acclSend", 
-			"curl_global_init() failed: %s",
-			ACCL_LOG_LEVEL_ERROR,
-			curl_easy_strerror(res));
-#endif
-		return ACCL_CURL_INITIALIZATION_ERROR;
+	for (i = 0; compression_levels[i].throughput != 0; i++) {
+		if (throughput < compression_levels[i].throughput)
+			break;
 	}
-	
-	GetAspirePortalEndpoint();
 
-	sprintf(aspire_portal_uri, "%s/send/%d/%s", endpoint, T_ID, GetAspireApplicationId());
+	return compression_levels[i].level;
+}
 
-	curl = curl_easy_init();
-	
-	if (curl) {
-		// payload structure initialization
-		payload.technique_id = T_ID;
-		payload.application_id = GetAspireApplicationId();
-		payload.payload_size = payloadBufferSize;
-		payload.payload_buffer = (char*)pPayloadBuffer;	
-		payload.transmit_offset = 0;
-		payload.error = ACCL_SUCCESS;
-	
-		// first set the Aspire Portal Endpoint
-		curl_easy_setopt(curl, CURLOPT_URL, aspire_portal_uri);
-		
-		// data will be POST-ed 
-	    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, payload.payload_size);
-		
-		// follow redirections
-		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-	 	curl_easy_setopt(curl, CURLOPT_POSTREDIR, 3);
-	 	    			   		   		
-   		// data sending callback setup and point to pass it
-	    curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_callback);
-	    curl_easy_setopt(curl, CURLOPT_READDATA, &payload);
-
-	    // cURL verbosity for debug purposes
-	    if (ACCL_LOG_LEVEL < ACCL_LOG_LEVEL_DEBUG)
-		    curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-		
-   		// Perform the request, res will get the return code
-   		res = curl_easy_perform(curl);
-   		
-   		curl_slist_free_all(chunk);
-
-   		// Check for errors
-   		if(res != CURLE_OK){
-#ifndef NDEBUG
-			acclLOG("acclSend", 
-				"curl_easy_perform() failed: %s\n",
-				ACCL_LOG_LEVEL_ERROR,
-				curl_easy_strerror(res));
-#endif
-			return ACCL_GENERIC_ERROR;
-		} 
-		
-		// verify response code
-		curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE,
-			&http_response_code);
+/*
+	Updates the upload throughput estimate after a completed transfer
+*/
+static void acclCompressionSample(accl_compression* compression, CURL* curl) {
+	curl_off_t uploaded = 0;
+	curl_off_t speed = 0;
+	unsigned long throughput;
 
-#ifndef NDEBUG
-		acclLOG("ACCL", "Response received from server RETURN CODE: %d.",
-			ACCL_LOG_LEVEL_INFO, http_response_code);
-#endif
+	if (!__atomic_load_n(&compression->enabled, __ATOMIC_RELAXED))
+		return;
 
-		if (http_response_code == 200)
-			returnValue = ACCL_SUCCESS;
-		else
-			returnValue = ACCL_SERVER_ERROR;
+	// small uploads are dominated by latency, not by bandwidth
+	if (CURLE_OK != curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &uploaded) ||
+			uploaded < (curl_off_t)__atomic_load_n(&compression->threshold, __ATOMIC_RELAXED))
+		return;
 
-   		// cleanup
-   		curl_easy_cleanup(curl);
-   		
-   		return returnValue;
-	} else {
-		return ACCL_CURL_INITIALIZATION_ERROR;	
-	}
+	if (CURLE_OK != curl_easy_getinfo(curl, CURLINFO_SPEED_UPLOAD_T, &speed) || speed <= 0)
+		return;
+
+	// exponentially weighted moving average, alpha = 1/8
+	throughput = __atomic_load_n(&compression->throughput, __ATOMIC_RELAXED);
+
+	if (0 == throughput)
+		throughput = (unsigned long)speed;
+	else
+		throughput = throughput - throughput / 8 + (unsigned long)speed / 8;
+
+	__atomic_store_n(&compression->throughput, throughput, __ATOMIC_RELAXED);
 }
 
 /*
-	Custom data sending callback (invoked by libcurl)
+	gzip encodes the payload segments into a single buffer; the payload is
+	sent as is when compression does not make it smaller
 */
-size_t read_callback(void *ptr, size_t size, size_t nmemb, void *userp){
-	accl_payload_transfer *data = (accl_payload_transfer *)userp;
+static int acclCompressPayload(accl_compression* compression, accl_payload_transfer* payload) {
+	z_stream stream;
+	unsigned char* buffer;
+	unsigned long capacity;
+	unsigned int i;
+	int res = Z_OK;
 
-#ifndef NDEBUG
-	acclLOG("read_callback",
-		"size %d payload size %d",
-		ACCL_LOG_LEVEL_DEBUG,
-		(int)size * (int)nmemb,
-		data->payload_size);
-#endif
+	memset(&stream, 0, sizeof(stream));
 
-	// callback called for no actual data transfer
-	if (size * nmemb < 1) {
-#ifndef NDEBUG
-		acclLOG("read_callback", "size * nmemb < 1", ACCL_LOG_LEVEL_DEBUG);
-#endif
+	// windowBits + 16: gzip wrapper
+	if (Z_OK != deflateInit2(&stream, acclCompressionLevel(compression), Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY))
+		return 0;
+
+	capacity = deflateBound(&stream, payload->payload_size);
+	buffer = (unsigned char*)malloc(capacity);
+
+	if (NULL == buffer) {
+		deflateEnd(&stream);
 		return 0;
 	}
 
-	if (data->payload_size > data->transmit_offset) {
-		// compute how much data to senda is left
-		int bytes_to_transfer = MIN(data->payload_size - data->transmit_offset,
-									ACCL_BLOCK_SIZE);
+	stream.next_out = buffer;
+	stream.avail_out = capacity;
 
-		// copy data from input buffer
-		memcpy (ptr,
-				data->payload_buffer + data->transmit_offset,
-				bytes_to_transfer);
+	for (i = 0; i < payload->segment_count && res == Z_OK; i++) {
+		stream.next_in = (Bytef*)payload->segments[i].base;
+		stream.avail_in = payload->segments[i].length;
 
-		// advances transmission offset
-		data->transmit_offset += bytes_to_transfer;
+		res = deflate(&stream, (i + 1 == payload->segment_count) ? Z_FINISH : Z_NO_FLUSH);
+	}
 
-		return bytes_to_transfer;
-	} else {
+	deflateEnd(&stream);
+
+	if (res != Z_STREAM_END || stream.total_out >= payload->payload_size) {
+		free(buffer);
 		return 0;
 	}
+
+#ifndef NDEBUG
+	acclLOG("acclCompressPayload", "payload compressed from %d to %d bytes",
+		ACCL_LOG_LEVEL_DEBUG,
+		payload->payload_size,
+		(int)stream.total_out);
+#endif
+
+	payload->encoded_buffer = buffer;
+	payload->encoded_size = (unsigned int)stream.total_out;
+	payload->http_headers = curl_slist_append(payload->http_headers, "Content-Encoding: gzip");
+
+	return 1;
 }
 
+static int seek_callback(void *userp, curl_off_t offset, int origin);
+static size_t producer_read(void *ptr, size_t size, size_t nmemb, void *userp);
+
 /*
-	Custom data receiving callback (invoked by libcurl)
+	Connection related setup, shared by requests and warm-up
 */
-size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userdata) {
-	accl_response* response = (accl_response*)userdata;
+static void acclHttpConnectionSetup(CURL* curl, accl_http_pool* pool, accl_timeouts* timeouts, const unsigned int deadline) {
+	// shared connection cache
+	curl_easy_setopt(curl, CURLOPT_SHARE, pool->share);
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
 
-#ifndef NDEBUG
-	acclLOG("write_callback",
-		"size=%d offset=%d",
-		ACCL_LOG_LEVEL_DEBUG,
-		size * nmemb,
-		response->output_buffer_size);
-#endif
+	// keep one idle connection per pooled handle (cURL default is 5)
+	curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, (long)ACCL_HTTP_POOL_SIZE);
 
-	// maximum buffer size check
-	if (size * nmemb + response->output_buffer_size > ACCL_MAX_BUFFER_SIZE) {
+	// portal addresses stay resolved (cURL default is 60 seconds)
+	curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, (long)ACCL_DNS_CACHE_TIMEOUT);
 
-#ifndef NDEBUG
-		acclLOG("write_callback", "return buffer size exceeded (%d requested)",
-			ACCL_LOG_LEVEL_ERROR,
-			size * nmemb + response->output_buffer_size);
-#endif
-		response->error = ACCL_OUTPUT_BUFFER_MAX_SIZE_EXCEEDED;
+	acclTimeoutsSetup(curl, timeouts, deadline);
+}
 
-		// cause curl abort current transfer
-		return -1;
+/*
+	Common request setup for the exchange and send primitives
+*/
+static void acclHttpSetup(CURL* curl, accl_http_pool* pool, accl_timeouts* timeouts, accl_compression* compression,
+	const char* uri, accl_payload_transfer* payload, accl_response* response) {
+
+	acclHttpConnectionSetup(curl, pool, timeouts, payload->timeout);
+
+	// first set the Aspire Portal Endpoint
+	curl_easy_setopt(curl, CURLOPT_URL, uri);
+
+	// data will be POST-ed
+	curl_easy_setopt(curl, CURLOPT_POST, 1L);
+
+	// follow redirections
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(curl, CURLOPT_POSTREDIR, 3);
+
+	if ((ACCL_COMPRESSION_INHERIT == payload->compression) ?
+			__atomic_load_n(&compression->enabled, __ATOMIC_RELAXED) : payload->compression) {
+		// compressed responses are decoded by cURL
+		curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+
+		if (NULL == payload->producer &&
+				payload->payload_size >= __atomic_load_n(&compression->threshold, __ATOMIC_RELAXED))
+			acclCompressPayload(compression, payload);
 	}
 
-	// allocates necessary memory
-	if (0 == response->output_buffer) {
-		// return buffer should be initialized
-		response->output_buffer = (char*)malloc(size * nmemb);
+	if (NULL != payload->producer) {
+		// size is not known in advance: chunked transfer encoding, memory
+		// use is bounded by the cURL upload buffer
+		payload->http_headers = curl_slist_append(payload->http_headers, "Transfer-Encoding: chunked");
+		payload->http_headers = curl_slist_append(payload->http_headers, "Expect:");
+
+		curl_easy_setopt(curl, CURLOPT_UPLOAD_BUFFERSIZE, (long)ACCL_UPLOAD_CHUNK_SIZE);
+		curl_easy_setopt(curl, CURLOPT_READFUNCTION, producer_read);
+		curl_easy_setopt(curl, CURLOPT_READDATA, payload);
+	} else if (NULL != payload->encoded_buffer) {
+		// compressed payload
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, payload->encoded_size);
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload->encoded_buffer);
+	} else if (1 == payload->segment_count) {
+		// contiguous payload is handed to cURL as is, without copies
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, payload->payload_size);
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload->segments[0].base);
 	} else {
-		// return buffer should be reallocated adding size * nmemb bytes
-		response->output_buffer = (char*)realloc(
-						(void*)response->output_buffer,
-						size * nmemb + response->output_buffer_size);
-	}
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, payload->payload_size);
 
-	if (0 == response->output_buffer) {
-		response->error = ACCL_OUTPUT_BUFFER_ALLOCATION_ERROR;
+		// data sending callback setup and point to pass it
+		curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_callback);
+		curl_easy_setopt(curl, CURLOPT_READDATA, payload);
 
-		// cause curl abort current transfer
-		return -1;
+		// rewind support, needed when a redirection is followed
+		curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, seek_callback);
+		curl_easy_setopt(curl, CURLOPT_SEEKDATA, payload);
 	}
 
-	// copy data to return structure
-	memcpy (response->output_buffer + response->output_buffer_size,
-				ptr,
-				size * nmemb);
+	if (NULL != payload->http_headers)
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, payload->http_headers);
 
-	// advance receiving offset
-	response->output_buffer_size += (int)(nmemb * size);
+	// data receiving callback setup and point to pass it
+	if (NULL != response) {
+		response->curl_handle = curl;
 
-	return (nmemb * size);
-}
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+	}
 
-#ifndef NDEBUG
+	// cURL verbosity for debug purposes
+	if (ACCL_LOG_LEVEL < ACCL_LOG_LEVEL_DEBUG)
+		curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+}
 
-/* TODO make logging thread safe: 
-	good start point 
-http://stackoverflow.com/questions/14903555/c-thread-safe-logging-to-a-file */
+/* retry classes of a failed request (accl_payload_transfer.failure) */
+#define ACCL_FAILURE_FINAL		0		/* retrying cannot help */
+#define ACCL_FAILURE_UNSENT		1		/* never reached the ASPIRE Portal */
+#define ACCL_FAILURE_TRANSIENT	2		/* may have been processed, retry if idempotent */
 
 /*
-	Logging utility
+	Maps the outcome of a completed transfer to an ACCL return value
 */
-void acclLOG(const char* tag, const char* fmt, int lvl, ...) {
-	FILE * fp;
+static int acclHttpResult(const char* tag, CURL* curl, CURLcode res, accl_payload_transfer* payload, accl_response* response) {
+	long http_response_code = 0;
+	double connect_time = 0;
+
+#ifdef NDEBUG
+	(void)tag;
+#endif
+
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_response_code);
+
+	if (NULL != payload) {
+		payload->failure = ACCL_FAILURE_FINAL;
+		payload->answered = (http_response_code > 0);
+	}
+
+	// Check for errors
+	if (res != CURLE_OK) {
+#ifndef NDEBUG
+		acclLOG(tag,
+			"curl_easy_perform() failed: %s\n",
+			ACCL_LOG_LEVEL_ERROR,
+			curl_easy_strerror(res));
+#endif
+		if (NULL != payload && payload->error != ACCL_SUCCESS)
+			return payload->error;
+
+		if (NULL != response && response->error != ACCL_SUCCESS)
+			return response->error;
+
+		// a timeout before the connection came up: the node drops packets
+		if (res == CURLE_OPERATION_TIMEDOUT)
+			curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connect_time);
+
+		if (NULL != payload)
+			payload->failure = (res == CURLE_COULDNT_RESOLVE_PROXY || res == CURLE_COULDNT_RESOLVE_HOST ||
+				res == CURLE_COULDNT_CONNECT || (res == CURLE_OPERATION_TIMEDOUT && 0 == connect_time)) ?
+				ACCL_FAILURE_UNSENT : ACCL_FAILURE_TRANSIENT;
+
+		// connect, total and low speed limits alike
+		if (res == CURLE_OPERATION_TIMEDOUT)
+			return ACCL_TIMEOUT;
+
+		return ACCL_GENERIC_ERROR;
+	}
+
+	// verify response code
+#ifndef NDEBUG
+	acclLOG("ACCL", "Response received from server RETURN CODE: %ld.",
+		ACCL_LOG_LEVEL_INFO, http_response_code);
+#endif
+
+	if (http_response_code != 200) {
+#ifndef NDEBUG
+		acclLOG(tag,
+			"server error: HTTP %ld\n",
+			ACCL_LOG_LEVEL_ERROR,
+			http_response_code);
+#endif
+		if (NULL != payload && (http_response_code >= 500 || http_response_code == 408 || http_response_code == 429))
+			payload->failure = ACCL_FAILURE_TRANSIENT;
+
+		return ACCL_SERVER_ERROR;
+	}
+
+	return ACCL_SUCCESS;
+}
+
+/*
+	ACCL technique registry
+	one entry per technique with its WebSockets port and default policy:
+	open addressing on the technique id, readers copy the entry under a
+	read lock; acclRegisterTechnique extends it at runtime
+*/
+static const accl_technique registry_defaults[] = {
+	{ .technique_id = ACCL_TID_CODE_SPLITTING,			.ws_port = 8082, .priority = ACCL_PRIORITY_INTERACTIVE },
+	{ .technique_id = ACCL_TID_CODE_MOBILITY,			.priority = ACCL_PRIORITY_INTERACTIVE },
+	{ .technique_id = ACCL_TID_DATA_MOBILITY,			.priority = ACCL_PRIORITY_INTERACTIVE },
+	{ .technique_id = ACCL_TID_WBS,						.priority = ACCL_PRIORITY_NORMAL },
+	{ .technique_id = ACCL_TID_MTC_CRYPTO_SERVER,		.priority = ACCL_PRIORITY_NORMAL },
+	{ .technique_id = ACCL_TID_DIVERSIFIED_CRYPTO,		.priority = ACCL_PRIORITY_NORMAL },
+	{ .technique_id = ACCL_TID_CG_HASH_RANDOMIZATION,	.priority = ACCL_PRIORITY_NORMAL },
+	{ .technique_id = ACCL_TID_CG_HASH_VERIFICATION,	.priority = ACCL_PRIORITY_NORMAL },
+	{ .technique_id = ACCL_TID_CFGT_REMOVE_VERIFIER,	.priority = ACCL_PRIORITY_NORMAL },
+	{ .technique_id = ACCL_TID_AC_DECISION_LOGIC,		.priority = ACCL_PRIORITY_INTERACTIVE },
+	{ .technique_id = ACCL_TID_AC_STATUS_LOGIC,			.priority = ACCL_PRIORITY_NORMAL },
+	{ .technique_id = ACCL_TID_RA_REACTION_MANAGER,		.ws_port = 8083, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_TID_RA_VERIFIER,				.ws_port = 8084, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RENEWABILITY,				.ws_port = 18001, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_0,				.ws_port = 8090, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_1,				.ws_port = 8091, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_2,				.ws_port = 8092, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_3,				.ws_port = 8093, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_4,				.ws_port = 8094, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_5,				.ws_port = 8095, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_6,				.ws_port = 8096, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_7,				.ws_port = 8097, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_8,				.ws_port = 8098, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_RA_ATTESTATOR_9,				.ws_port = 8099, .priority = ACCL_PRIORITY_BACKGROUND },
+	{ .technique_id = ACCL_TID_TEST,					.priority = ACCL_PRIORITY_NORMAL }
+};
+
+static struct {
+	pthread_once_t once;
+	pthread_rwlock_t lock;						/* protects everything below */
+	accl_technique entries[ACCL_REGISTRY_SIZE];	/* technique_id 0: free slot */
+	unsigned int count;
+} registry = { PTHREAD_ONCE_INIT };
+
+/* registry->lock held; slot of T_ID, or the free slot where it goes */
+static unsigned int acclRegistrySlot(const int T_ID) {
+	unsigned int slot = ((unsigned int)T_ID * 2654435761u) & (ACCL_REGISTRY_SIZE - 1);
+
+	while (0 != registry.entries[slot].technique_id && T_ID != registry.entries[slot].technique_id)
+		slot = (slot + 1) & (ACCL_REGISTRY_SIZE - 1);
+
+	return slot;
+}
+
+/* registry->lock held for writing */
+static int acclRegistryStore(const accl_technique* technique) {
+	unsigned int slot = acclRegistrySlot(technique->technique_id);
+
+	if (0 == registry.entries[slot].technique_id) {
+		// half full at most, probe sequences stay short
+		if (registry.count >= ACCL_REGISTRY_SIZE / 2)
+			return ACCL_GENERIC_ERROR;
+
+		registry.count++;
+	}
+
+	registry.entries[slot] = *technique;
+
+	// policy values the request path relies on
+	registry.entries[slot].retry_attempts = MAX(technique->retry_attempts, 1);
+	registry.entries[slot].retry_max_backoff = MAX(technique->retry_max_backoff, technique->retry_backoff);
+
+	if (0 == technique->ws_port)
+		registry.entries[slot].ws_port = ACCL_WS_ASPIRE_PORTAL_PORT;
+
+	if (0 == technique->ws_queue_budget)
+		registry.entries[slot].ws_queue_budget = ACCL_WS_QUEUE_BUDGET;
+
+	if (0 == technique->ws_deflate_window_bits)
+		registry.entries[slot].ws_deflate_window_bits = ACCL_WS_DEFLATE_WINDOW_BITS;
+
+	if (0 == technique->ws_deflate_mem_level)
+		registry.entries[slot].ws_deflate_mem_level = ACCL_WS_DEFLATE_MEM_LEVEL;
+
+	return ACCL_SUCCESS;
+}
+
+static void acclRegistryInit(void) {
+	accl_technique technique;
+	unsigned int i;
+
+	pthread_rwlock_init(&registry.lock, NULL);
+
+	for (i = 0; i < sizeof(registry_defaults) / sizeof(registry_defaults[0]); i++) {
+		technique = registry_defaults[i];
+
+		// built-in entries follow the client compression setting; the
+		// deflate offer stays opt-in, portals may not know it
+		technique.compression = ACCL_COMPRESSION_INHERIT;
+
+		acclRegistryStore(&technique);
+	}
+}
+
+/*
+	Copies the registry entry of a technique, 0 when it is unknown
+*/
+static int acclRegistryLookup(const int T_ID, accl_technique* technique) {
+	unsigned int slot;
+	int found;
+
+	pthread_once(&registry.once, acclRegistryInit);
+
+	// 0 marks the free slots
+	if (0 == T_ID)
+		return 0;
+
+	pthread_rwlock_rdlock(&registry.lock);
+	slot = acclRegistrySlot(T_ID);
+	found = (0 != registry.entries[slot].technique_id);
+	if (found)
+		*technique = registry.entries[slot];
+	pthread_rwlock_unlock(&registry.lock);
+
+	return found;
+}
+
+/*
+	Identifiers of the techniques preferring a transport, at most max
+*/
+static unsigned int acclRegistryList(const int transport, int* techniqueIds, const unsigned int max) {
+	unsigned int count = 0;
+	unsigned int i;
+
+	pthread_once(&registry.once, acclRegistryInit);
+
+	pthread_rwlock_rdlock(&registry.lock);
+	for (i = 0; i < ACCL_REGISTRY_SIZE && count < max; i++) {
+		if (0 != registry.entries[i].technique_id && transport == registry.entries[i].transport)
+			techniqueIds[count++] = registry.entries[i].technique_id;
+	}
+	pthread_rwlock_unlock(&registry.lock);
+
+	return count;
+}
+
+int acclRegisterTechnique(const accl_technique* technique) {
+	int returnValue;
+
+	pthread_once(&registry.once, acclRegistryInit);
+
+	// PARAMETERS SANITY CHECK
+	if (NULL == technique || technique->technique_id <= 0)
+		return ACCL_UNKNOWN_TECHNIQUE_ID;
+
+	if ((technique->transport != ACCL_TRANSPORT_HTTP && technique->transport != ACCL_TRANSPORT_WEBSOCKETS) ||
+			technique->ws_port < 0 || technique->ws_port > 65535 ||
+			technique->compression < ACCL_COMPRESSION_INHERIT || technique->compression > 1 ||
+			technique->ws_deflate < 0 || technique->ws_deflate > 1 ||
+			(0 != technique->ws_deflate_window_bits && (technique->ws_deflate_window_bits < 9 || technique->ws_deflate_window_bits > 15)) ||
+			technique->ws_deflate_mem_level > 9 ||
+			technique->priority < ACCL_PRIORITY_BACKGROUND || technique->priority > ACCL_PRIORITY_INTERACTIVE) {
+#ifndef NDEBUG
+		acclLOG("acclRegisterTechnique",
+			"invalid policy for technique id %d",
+			ACCL_LOG_LEVEL_ERROR,
+			technique->technique_id);
+#endif
+		return ACCL_GENERIC_ERROR;
+	}
+
+	pthread_rwlock_wrlock(&registry.lock);
+	returnValue = acclRegistryStore(technique);
+	pthread_rwlock_unlock(&registry.lock);
+
+#ifndef NDEBUG
+	if (returnValue != ACCL_SUCCESS)
+		acclLOG("acclRegisterTechnique", "registry full", ACCL_LOG_LEVEL_ERROR);
+#endif
+
+	return returnValue;
+}
+
+int acclGetTechnique(const int T_ID, accl_technique* technique) {
+	if (NULL == technique || !acclRegistryLookup(T_ID, technique))
+		return ACCL_UNKNOWN_TECHNIQUE_ID;
+
+	return ACCL_SUCCESS;
+}
+
+/*
+	Technique id check shared by the HTTP primitives; technique, when not
+	NULL, receives the registry entry
+*/
+static int acclCheckTechnique(const char* tag, const int T_ID, accl_technique* technique) {
+	accl_technique entry;
+
+#ifdef NDEBUG
+	(void)tag;
+#endif
+
+	if (!acclRegistryLookup(T_ID, (NULL != technique) ? technique : &entry)) {
+#ifndef NDEBUG
+		acclLOG(tag,
+			"unknown technique id: %d",
+			ACCL_LOG_LEVEL_ERROR,
+			T_ID);
+#endif
+		return ACCL_UNKNOWN_TECHNIQUE_ID;
+	}
+
+	return ACCL_SUCCESS;
+}
+
+/*
+	Parameters sanity check shared by the HTTP primitives
+*/
+static int acclCheckRequest(const char* tag, const int T_ID, const int payloadBufferSize, accl_technique* technique) {
+	// buffer size check
+	if (payloadBufferSize <= 0){
+#ifndef NDEBUG
+		acclLOG(tag,
+			"payload buffer size not valid (%d bytes specified)",
+			ACCL_LOG_LEVEL_ERROR,
+			payloadBufferSize);
+#endif
+		return ACCL_INPUT_BUFFER_ERROR;
+	}
+
+	if (payloadBufferSize > ACCL_MAX_BUFFER_SIZE) {
+#ifndef NDEBUG
+		acclLOG(tag,
+			"payload maximum size is %d bytes, %d bytes provided",
+			ACCL_LOG_LEVEL_ERROR,
+			ACCL_MAX_BUFFER_SIZE,
+			payloadBufferSize);
+#endif
+		return ACCL_INPUT_BUFFER_MAX_SIZE_EXCEEDED;
+	}
+
+	return acclCheckTechnique(tag, T_ID, technique);
+}
+
+/*
+	Prepares a response structure; a caller supplied buffer is filled in
+	place and never reallocated
+*/
+static void acclResponseInit(accl_response* response, char* buffer, unsigned int capacity) {
+	response->output_buffer_size = 0;
+	response->output_buffer = buffer;
+	response->output_buffer_capacity = capacity;
+	response->external_buffer = (NULL != buffer);
+	response->curl_handle = NULL;
+	response->stream_callback = NULL;
+	response->stream_user_data = NULL;
+	response->error = ACCL_SUCCESS;
+}
+
+/*
+	Total size of a scatter-gather payload; anything above the maximum is
+	clamped so that acclCheckRequest reports it as such
+*/
+static int acclSegmentsSize(const accl_iovec* segments, const unsigned int segmentCount) {
+	unsigned long long total = 0;
+	unsigned int i;
+
+	if (NULL == segments)
+		return 0;
+
+	for (i = 0; i < segmentCount; i++) {
+		if (NULL == segments[i].base && segments[i].length > 0)
+			return 0;
+
+		total += segments[i].length;
+	}
+
+	return (int)MIN(total, (unsigned long long)ACCL_MAX_BUFFER_SIZE + 1);
+}
+
+/*
+	Payload structure initialization
+*/
+static void acclPayloadInit(accl_payload_transfer* payload, char* application_id, const int T_ID, const accl_iovec* segments, const unsigned int segmentCount, const int payloadBufferSize) {
+	payload->technique_id = T_ID;
+	payload->application_id = application_id;
+	payload->payload_size = payloadBufferSize;
+	payload->payload_buffer = (1 == segmentCount) ? (char*)segments[0].base : NULL;
+	payload->transmit_offset = 0;
+	payload->error = ACCL_SUCCESS;
+	payload->segments = segments;
+	payload->segment_count = segmentCount;
+	payload->segment_index = 0;
+	payload->segment_offset = 0;
+	payload->producer = NULL;
+	payload->producer_user_data = NULL;
+	payload->http_headers = NULL;
+	payload->encoded_buffer = NULL;
+	payload->encoded_size = 0;
+	payload->timeout = 0;
+	payload->compression = ACCL_COMPRESSION_INHERIT;
+	payload->failure = ACCL_FAILURE_FINAL;
+	payload->answered = 0;
+}
+
+/*
+	Releases what acclHttpSetup attached to the payload
+*/
+static void acclPayloadRelease(accl_payload_transfer* payload) {
+	curl_slist_free_all((struct curl_slist*)payload->http_headers);
+	payload->http_headers = NULL;
+
+	free(payload->encoded_buffer);
+	payload->encoded_buffer = NULL;
+}
+
+/*
+	ACCL response cache
+	opt-in per technique: responses of idempotent exchanges are kept in
+	memory (LRU, bounded by a memory budget) and optionally in a disk tier
+	read through mmap, keyed by technique id, application id and payload
+*/
+typedef struct accl_cache_entry {
+	unsigned long long hash;				/* key hash */
+	int technique_id;
+	time_t expires;							/* wall clock expiration */
+	unsigned int payload_size;
+	unsigned int response_size;
+	struct accl_cache_entry* bucket_next;	/* hash chain */
+	struct accl_cache_entry* lru_prev;		/* more recently used */
+	struct accl_cache_entry* lru_next;		/* less recently used */
+	/* payload and response follow */
+} accl_cache_entry;
+
+/* disk tier file layout: header, payload, response */
+typedef struct accl_cache_file_header {
+	unsigned int magic;
+	int technique_id;
+	long long expires;
+	unsigned long long hash;
+	unsigned int payload_size;
+	unsigned int response_size;
+} accl_cache_file_header;
+
+#define ACCL_CACHE_FILE_MAGIC	0x4c434341		/* "ACCL" */
+
+typedef struct accl_cache {
+	pthread_mutex_t mutex;					/* protects everything below */
+	accl_cache_entry* buckets[ACCL_CACHE_BUCKETS];
+	accl_cache_entry* lru_head;
+	accl_cache_entry* lru_tail;
+	size_t memory_used;
+	size_t memory_budget;
+	char disk_path[PATH_MAX];				/* empty: no disk tier */
+	size_t disk_used;						/* estimate, exact after each sweep */
+	int disk_sweeping;
+	struct {
+		int technique_id;
+		unsigned int ttl;					/* seconds */
+	} policies[ACCL_CACHE_MAX_TECHNIQUES];
+	int policy_count;
+} accl_cache;
+
+static void acclCacheInit(accl_cache* cache) {
+	memset(cache, 0, sizeof(accl_cache));
+
+	pthread_mutex_init(&cache->mutex, NULL);
+	cache->memory_budget = ACCL_CACHE_MEMORY_BUDGET;
+}
+
+/*
+	Drops the memory tier, the disk tier is left in place
+*/
+static void acclCacheDestroy(accl_cache* cache) {
+	accl_cache_entry* entry;
+
+	while (NULL != (entry = cache->lru_head)) {
+		cache->lru_head = entry->lru_next;
+		free(entry);
+	}
+
+	pthread_mutex_destroy(&cache->mutex);
+}
+
+/*
+	FNV-1a over technique id, application id and payload segments
+*/
+static unsigned long long acclCacheHash(const int T_ID, const char* app_id, const accl_iovec* segments, const unsigned int segmentCount) {
+	unsigned long long hash = 14695981039346656037ULL;
+	const unsigned char* p;
+	unsigned int i, j;
+
+	for (i = 0; i < sizeof(T_ID); i++)
+		hash = (hash ^ ((T_ID >> (8 * i)) & 0xff)) * 1099511628211ULL;
+
+	for (p = (const unsigned char*)app_id; *p; p++)
+		hash = (hash ^ *p) * 1099511628211ULL;
+
+	for (i = 0; i < segmentCount; i++) {
+		p = (const unsigned char*)segments[i].base;
+
+		for (j = 0; j < segments[i].length; j++)
+			hash = (hash ^ p[j]) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/*
+	Exact payload comparison, hashes only select the candidates
+*/
+static int acclCacheMatch(const char* stored, const accl_iovec* segments, const unsigned int segmentCount) {
+	unsigned int i;
+
+	for (i = 0; i < segmentCount; i++) {
+		if (0 != memcmp(stored, segments[i].base, segments[i].length))
+			return 0;
+
+		stored += segments[i].length;
+	}
+
+	return 1;
+}
+
+/*
+	Caching time to live of a technique, 0 when caching is off; techniques
+	the client did not configure keep their registry ttl
+*/
+static unsigned int acclCacheTtl(accl_cache* cache, const int T_ID, const unsigned int registry_ttl) {
+	unsigned int ttl = registry_ttl;
+	int i;
+
+	// fast path: no technique configured
+	if (0 == __atomic_load_n(&cache->policy_count, __ATOMIC_ACQUIRE))
+		return ttl;
+
+	pthread_mutex_lock(&cache->mutex);
+	for (i = 0; i < cache->policy_count; i++) {
+		if (cache->policies[i].technique_id == T_ID) {
+			ttl = cache->policies[i].ttl;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&cache->mutex);
+
+	return ttl;
+}
+
+/* cache->mutex held */
+static void acclCacheUnlink(accl_cache* cache, accl_cache_entry* entry) {
+	accl_cache_entry** link = &cache->buckets[entry->hash % ACCL_CACHE_BUCKETS];
+
+	while (*link != entry)
+		link = &(*link)->bucket_next;
+	*link = entry->bucket_next;
+
+	if (NULL != entry->lru_prev)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		cache->lru_head = entry->lru_next;
+
+	if (NULL != entry->lru_next)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		cache->lru_tail = entry->lru_prev;
+
+	cache->memory_used -= sizeof(accl_cache_entry) + entry->payload_size + entry->response_size;
+}
+
+/* cache->mutex held */
+static void acclCacheLink(accl_cache* cache, accl_cache_entry* entry) {
+	accl_cache_entry** bucket = &cache->buckets[entry->hash % ACCL_CACHE_BUCKETS];
+
+	entry->bucket_next = *bucket;
+	*bucket = entry;
+
+	entry->lru_prev = NULL;
+	entry->lru_next = cache->lru_head;
+
+	if (NULL != cache->lru_head)
+		cache->lru_head->lru_prev = entry;
+	else
+		cache->lru_tail = entry;
+
+	cache->lru_head = entry;
+
+	cache->memory_used += sizeof(accl_cache_entry) + entry->payload_size + entry->response_size;
+}
+
+/*
+	Adds an entry to the memory tier, evicting least recently used entries
+	to stay within the memory budget
+*/
+static void acclCacheInsert(accl_cache* cache, const unsigned long long hash, const int T_ID, const time_t expires,
+		const accl_iovec* segments, const unsigned int segmentCount, const unsigned int payloadSize,
+		const char* response, const unsigned int responseSize) {
+
+	accl_cache_entry* entry;
+	accl_cache_entry* old;
+	size_t footprint = sizeof(accl_cache_entry) + payloadSize + responseSize;
+	char* data;
+	unsigned int i;
+
+	entry = (accl_cache_entry*)malloc(footprint);
+
+	if (NULL == entry)
+		return;
+
+	entry->hash = hash;
+	entry->technique_id = T_ID;
+	entry->expires = expires;
+	entry->payload_size = payloadSize;
+	entry->response_size = responseSize;
+
+	data = (char*)(entry + 1);
+
+	for (i = 0; i < segmentCount; i++) {
+		memcpy(data, segments[i].base, segments[i].length);
+		data += segments[i].length;
+	}
+
+	memcpy(data, response, responseSize);
+
+	pthread_mutex_lock(&cache->mutex);
+
+	if (footprint > cache->memory_budget) {
+		pthread_mutex_unlock(&cache->mutex);
+		free(entry);
+		return;
+	}
+
+	// replace a previous response for the same request
+	for (old = cache->buckets[hash % ACCL_CACHE_BUCKETS]; NULL != old; old = old->bucket_next) {
+		if (old->hash == hash && old->technique_id == T_ID && old->payload_size == payloadSize &&
+				acclCacheMatch((char*)(old + 1), segments, segmentCount)) {
+			acclCacheUnlink(cache, old);
+			free(old);
+			break;
+		}
+	}
+
+	while (cache->memory_used + footprint > cache->memory_budget && NULL != cache->lru_tail) {
+		old = cache->lru_tail;
+		acclCacheUnlink(cache, old);
+		free(old);
+	}
+
+	acclCacheLink(cache, entry);
+
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/* cache->mutex held, 0 when the name does not fit in PATH_MAX */
+static int acclCacheFileName(accl_cache* cache, char* file_name, const int T_ID, const unsigned long long hash) {
+	int length = snprintf(file_name, PATH_MAX, "%s/%d-%016llx.accl", cache->disk_path, T_ID, hash);
+
+	return length > 0 && length < PATH_MAX;
+}
+
+/*
+	Disk tier lookup: the file is mapped, validated and its response copied
+*/
+static int acclCacheDiskLookup(accl_cache* cache, const unsigned long long hash, const int T_ID,
+		const accl_iovec* segments, const unsigned int segmentCount, const unsigned int payloadSize,
+		char** response, unsigned int* responseSize, time_t* expires) {
+
+	char file_name[PATH_MAX];
+	accl_cache_file_header* header;
+	struct stat info;
+	void* map;
+	int fd;
+	int hit = 0;
+
+	pthread_mutex_lock(&cache->mutex);
+	if ('\0' == cache->disk_path[0] || !acclCacheFileName(cache, file_name, T_ID, hash))
+		file_name[0] = '\0';
+	pthread_mutex_unlock(&cache->mutex);
+
+	if ('\0' == file_name[0])
+		return 0;
+
+	fd = open(file_name, O_RDONLY);
+
+	if (fd < 0)
+		return 0;
+
+	if (0 != fstat(fd, &info) || info.st_size < (off_t)sizeof(accl_cache_file_header)) {
+		close(fd);
+		return 0;
+	}
+
+	map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (MAP_FAILED == map)
+		return 0;
+
+	header = (accl_cache_file_header*)map;
+
+	if (header->magic == ACCL_CACHE_FILE_MAGIC &&
+			header->hash == hash &&
+			header->technique_id == T_ID &&
+			header->payload_size == payloadSize &&
+			info.st_size == (off_t)(sizeof(accl_cache_file_header) + header->payload_size + header->response_size) &&
+			header->expires > (long long)time(NULL) &&
+			acclCacheMatch((const char*)(header + 1), segments, segmentCount)) {
+
+		*response = (char*)malloc(header->response_size ? header->response_size : 1);
+
+		if (NULL != *response) {
+			memcpy(*response, (const char*)(header + 1) + header->payload_size, header->response_size);
+			*responseSize = header->response_size;
+			*expires = (time_t)header->expires;
+			hit = 1;
+		}
+	} else if (header->magic == ACCL_CACHE_FILE_MAGIC && header->expires <= (long long)time(NULL)) {
+		// stale entry
+		unlink(file_name);
+	}
+
+	munmap(map, info.st_size);
+
+	return hit;
+}
+
+typedef struct accl_cache_file {
+	time_t written;
+	off_t size;
+	char name[NAME_MAX + 1];
+} accl_cache_file;
+
+static int acclCacheDirEntry(char* file_name, const char* path, const char* name) {
+	int length = snprintf(file_name, PATH_MAX, "%s/%s", path, name);
+
+	return length > 0 && length < PATH_MAX;
+}
+
+static int acclCacheFileOrder(const void* a, const void* b) {
+	time_t x = ((const accl_cache_file*)a)->written;
+	time_t y = ((const accl_cache_file*)b)->written;
+
+	return (x > y) - (x < y);
+}
+
+/*
+	Disk tier sweep: removes the expired files, then the oldest written
+	ones until the tier is back within 3/4 of ACCL_CACHE_DISK_BUDGET
+*/
+static void acclCacheDiskSweep(accl_cache* cache, const char* path) {
+	accl_cache_file* files = NULL;
+	accl_cache_file* grown;
+	accl_cache_file_header header;
+	struct dirent* dirent;
+	struct stat info;
+	char file_name[PATH_MAX];
+	size_t count = 0, capacity = 0, i;
+	size_t used = 0;
+	size_t length;
+	int fd, stale;
+	DIR* dir;
+
+	dir = opendir(path);
+
+	if (NULL != dir) {
+		while (NULL != (dirent = readdir(dir))) {
+			length = strlen(dirent->d_name);
+
+			if (length <= 5 || length > NAME_MAX || 0 != strcmp(dirent->d_name + length - 5, ".accl"))
+				continue;
+
+			if (!acclCacheDirEntry(file_name, path, dirent->d_name) || 0 != lstat(file_name, &info) || !S_ISREG(info.st_mode))
+				continue;
+
+			stale = 0;
+			fd = open(file_name, O_RDONLY);
+
+			if (fd >= 0) {
+				stale = ((ssize_t)sizeof(header) == read(fd, &header, sizeof(header)) &&
+					header.magic == ACCL_CACHE_FILE_MAGIC && header.expires <= (long long)time(NULL));
+				close(fd);
+			}
+
+			if (stale) {
+				unlink(file_name);
+				continue;
+			}
+
+			if (count == capacity) {
+				capacity = capacity ? 2 * capacity : 64;
+				grown = (accl_cache_file*)realloc(files, capacity * sizeof(accl_cache_file));
+
+				if (NULL == grown)
+					break;
+
+				files = grown;
+			}
+
+			memcpy(files[count].name, dirent->d_name, length + 1);
+			files[count].written = info.st_mtime;
+			files[count].size = info.st_size;
+			used += info.st_size;
+			count++;
+		}
+
+		closedir(dir);
+	}
+
+	if (used > ACCL_CACHE_DISK_BUDGET) {
+		qsort(files, count, sizeof(accl_cache_file), acclCacheFileOrder);
+
+		for (i = 0; i < count && used > ACCL_CACHE_DISK_BUDGET / 4 * 3; i++) {
+			if (acclCacheDirEntry(file_name, path, files[i].name) && 0 == unlink(file_name))
+				used -= files[i].size;
+		}
+	}
+
+	free(files);
+
+	pthread_mutex_lock(&cache->mutex);
+	cache->disk_used = used;
+	cache->disk_sweeping = 0;
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+/*
+	Disk tier store: written to a temporary file, then renamed in place
+*/
+static void acclCacheDiskStore(accl_cache* cache, const unsigned long long hash, const int T_ID, const time_t expires,
+		const accl_iovec* segments, const unsigned int segmentCount, const unsigned int payloadSize,
+		const char* response, const unsigned int responseSize) {
+
+	char file_name[PATH_MAX];
+	char temp_name[PATH_MAX];
+	accl_cache_file_header header;
+	FILE* fp;
+	unsigned int i;
+	int ok, length;
+	int sweep = 0;
+
+	pthread_mutex_lock(&cache->mutex);
+	if ('\0' == cache->disk_path[0] || !acclCacheFileName(cache, file_name, T_ID, hash))
+		file_name[0] = '\0';
+	pthread_mutex_unlock(&cache->mutex);
+
+	if ('\0' == file_name[0])
+		return;
+
+	length = snprintf(temp_name, sizeof(temp_name), "%s.%ld.tmp", file_name, (long)syscall(SYS_gettid));
+
+	if (length <= 0 || length >= (int)sizeof(temp_name))
+		return;
+
+	fp = fopen(temp_name, "wb");
+
+	if (NULL == fp)
+		return;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = ACCL_CACHE_FILE_MAGIC;
+	header.technique_id = T_ID;
+	header.expires = (long long)expires;
+	header.hash = hash;
+	header.payload_size = payloadSize;
+	header.response_size = responseSize;
+
+	ok = (1 == fwrite(&header, sizeof(header), 1, fp));
+
+	for (i = 0; ok && i < segmentCount; i++) {
+		if (segments[i].length > 0)
+			ok = (1 == fwrite(segments[i].base, segments[i].length, 1, fp));
+	}
+
+	if (ok && responseSize > 0)
+		ok = (1 == fwrite(response, responseSize, 1, fp));
+
+	if (0 != fclose(fp))
+		ok = 0;
+
+	if (!ok || 0 != rename(temp_name, file_name)) {
+		unlink(temp_name);
+		return;
+	}
+
+	// one thread at a time sweeps the tier back within its budget
+	pthread_mutex_lock(&cache->mutex);
+	cache->disk_used += sizeof(header) + payloadSize + responseSize;
+
+	if (cache->disk_used > ACCL_CACHE_DISK_BUDGET && !cache->disk_sweeping && '\0' != cache->disk_path[0]) {
+		cache->disk_sweeping = 1;
+		strcpy(temp_name, cache->disk_path);
+		sweep = 1;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (sweep)
+		acclCacheDiskSweep(cache, temp_name);
+}
+
+/*
+	Looks a response up, memory tier first; on a hit *response is a copy
+	owned by the caller
+*/
+static int acclCacheLookup(accl_cache* cache, const char* app_id, const int T_ID, const accl_iovec* segments, const unsigned int segmentCount,
+		const unsigned int payloadSize, char** response, unsigned int* responseSize) {
+
+	unsigned long long hash = acclCacheHash(T_ID, app_id, segments, segmentCount);
+	accl_cache_entry* entry;
+	time_t now = time(NULL);
+	time_t expires;
+	int hit = 0;
+
+	pthread_mutex_lock(&cache->mutex);
+
+	for (entry = cache->buckets[hash % ACCL_CACHE_BUCKETS]; NULL != entry; entry = entry->bucket_next) {
+		if (entry->hash == hash && entry->technique_id == T_ID && entry->payload_size == payloadSize &&
+				acclCacheMatch((char*)(entry + 1), segments, segmentCount))
+			break;
+	}
+
+	if (NULL != entry && entry->expires <= now) {
+		// expired
+		acclCacheUnlink(cache, entry);
+		free(entry);
+		entry = NULL;
+	}
+
+	if (NULL != entry) {
+		*response = (char*)malloc(entry->response_size ? entry->response_size : 1);
+
+		if (NULL != *response) {
+			memcpy(*response, (char*)(entry + 1) + entry->payload_size, entry->response_size);
+			*responseSize = entry->response_size;
+			hit = 1;
+
+			// most recently used
+			acclCacheUnlink(cache, entry);
+			acclCacheLink(cache, entry);
+		}
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (hit)
+		return 1;
+
+	// promote disk hits into the memory tier
+	if (acclCacheDiskLookup(cache, hash, T_ID, segments, segmentCount, payloadSize, response, responseSize, &expires)) {
+		acclCacheInsert(cache, hash, T_ID, expires, segments, segmentCount, payloadSize, *response, *responseSize);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void acclCacheStore(accl_cache* cache, const char* app_id, const int T_ID, const unsigned int ttl, const accl_iovec* segments,
+		const unsigned int segmentCount, const unsigned int payloadSize,
+		const char* response, const unsigned int responseSize) {
+
+	unsigned long long hash = acclCacheHash(T_ID, app_id, segments, segmentCount);
+	time_t expires = time(NULL) + ttl;
+
+	acclCacheInsert(cache, hash, T_ID, expires, segments, segmentCount, payloadSize, response, responseSize);
+	acclCacheDiskStore(cache, hash, T_ID, expires, segments, segmentCount, payloadSize, response, responseSize);
+}
+
+static int acclCachePolicy(accl_cache* cache, const int T_ID, const unsigned int ttl) {
+	int returnValue = ACCL_SUCCESS;
+	int i;
+
+	if (ACCL_SUCCESS != acclCheckTechnique("acclCachePolicy", T_ID, NULL))
+		return ACCL_UNKNOWN_TECHNIQUE_ID;
+
+	pthread_mutex_lock(&cache->mutex);
+
+	for (i = 0; i < cache->policy_count; i++) {
+		if (cache->policies[i].technique_id == T_ID)
+			break;
+	}
+
+	if (i < cache->policy_count) {
+		cache->policies[i].ttl = ttl;
+	} else if (i < ACCL_CACHE_MAX_TECHNIQUES) {
+		cache->policies[i].technique_id = T_ID;
+		cache->policies[i].ttl = ttl;
+		__atomic_store_n(&cache->policy_count, i + 1, __ATOMIC_RELEASE);
+	} else {
+		returnValue = ACCL_GENERIC_ERROR;
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	return returnValue;
+}
+
+static int acclCacheLimits(accl_cache* cache, const unsigned int memoryBudget, const char* diskPath) {
+	accl_cache_entry* entry;
+	int returnValue = ACCL_SUCCESS;
+
+	pthread_mutex_lock(&cache->mutex);
+
+	cache->memory_budget = memoryBudget;
+
+	// shrink to the new budget
+	while (cache->memory_used > cache->memory_budget && NULL != cache->lru_tail) {
+		entry = cache->lru_tail;
+		acclCacheUnlink(cache, entry);
+		free(entry);
+	}
+
+	if (NULL == diskPath) {
+		cache->disk_path[0] = '\0';
+	} else if (strlen(diskPath) < sizeof(cache->disk_path) - 64) {
+		// room left for the file names; the next store measures the tier
+		strcpy(cache->disk_path, diskPath);
+		cache->disk_used = (size_t)ACCL_CACHE_DISK_BUDGET + 1;
+	} else {
+		returnValue = ACCL_GENERIC_ERROR;
+	}
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	return returnValue;
+}
+
+/*
+	ACCL metrics
+	every thread updates its own shard of per technique counters with
+	relaxed atomics, readers merge the shards; latencies go in log-linear
+	(HDR style) histograms: 8 linear sub-buckets per power of two
+	microseconds, i.e. values are recorded within 1/8 of their magnitude
+*/
+#define ACCL_STATS_SUB_BITS		3
+#define ACCL_STATS_SUB_BUCKETS	(1 << ACCL_STATS_SUB_BITS)
+#define ACCL_STATS_MAGNITUDES	32		/* up to 2^32 microseconds */
+#define ACCL_STATS_BUCKETS		((ACCL_STATS_MAGNITUDES - ACCL_STATS_SUB_BITS + 1) * ACCL_STATS_SUB_BUCKETS)
+
+typedef struct accl_stats_counters {
+	unsigned long long calls;
+	unsigned long long errors;
+	unsigned long long retries;
+	unsigned long long hedges;
+	unsigned long long bytes_sent;
+	unsigned long long bytes_received;
+	unsigned long long latency_sum;
+	unsigned long long latency_max;
+	unsigned long long error_codes[ACCL_STATS_ERROR_SLOTS];
+	unsigned long long latency[ACCL_STATS_BUCKETS];
+} __attribute__((aligned(64))) accl_stats_counters;
+
+typedef struct accl_stats_technique {
+	int technique_id;						/* 0: free slot */
+	accl_stats_counters* shards;			/* ACCL_STATS_SHARDS, allocated on first use */
+} accl_stats_technique;
+
+/* tracked return values, in accl_stats.error_codes order; one per slot */
+static const int stats_error_codes[ACCL_STATS_ERROR_SLOTS] = {
+	ACCL_SUCCESS,
+	ACCL_CURL_INITIALIZATION_ERROR,
+	ACCL_INPUT_BUFFER_ERROR,
+	ACCL_INPUT_BUFFER_MAX_SIZE_EXCEEDED,
+	ACCL_OUTPUT_BUFFER_MAX_SIZE_EXCEEDED,
+	ACCL_OUTPUT_BUFFER_ALLOCATION_ERROR,
+	ACCL_STREAM_ABORTED,
+	ACCL_PRODUCER_ABORTED,
+	ACCL_UNKNOWN_TECHNIQUE_ID,
+	ACCL_BATCH_ERROR,
+	ACCL_SERVER_ERROR,
+	ACCL_WS_INVALID_CONTEXT,
+	ACCL_WS_ALREADY_SHUT_DOWN,
+	ACCL_WS_QUEUE_FULL,
+	ACCL_WS_CONNECTION_LOST,
+	ACCL_GENERIC_ERROR,
+	ACCL_INVALID_CLIENT,
+	ACCL_TIMEOUT,
+	-1										/* any other code */
+};
+
+static unsigned int stats_next_shard = 0;
+static __thread int stats_shard = -1;
+
+typedef struct accl_stats_dumper {
+	pthread_mutex_t mutex;					/* protects everything below */
+	pthread_cond_t wakeup;					/* signalled on stop */
+	accl_stats_technique* techniques;		/* what is dumped */
+	char path[1024];
+	unsigned int interval;					/* seconds */
+	int running;
+	int stopping;
+	pthread_t thread;
+} accl_stats_dumper;
+
+/*
+	Monotonic clock in microseconds
+*/
+static unsigned long long acclNow(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (unsigned long long)now.tv_sec * 1000000ULL + (unsigned long long)now.tv_nsec / 1000ULL;
+}
+
+static unsigned int acclStatsBucket(const unsigned long long value) {
+	unsigned int magnitude;
+	unsigned int index;
+
+	if (value < ACCL_STATS_SUB_BUCKETS)
+		return (unsigned int)value;
+
+	magnitude = 63 - __builtin_clzll(value);
+
+	index = (magnitude - ACCL_STATS_SUB_BITS + 1) * ACCL_STATS_SUB_BUCKETS
+		+ (unsigned int)((value >> (magnitude - ACCL_STATS_SUB_BITS)) & (ACCL_STATS_SUB_BUCKETS - 1));
+
+	return MIN(index, ACCL_STATS_BUCKETS - 1);
+}
+
+/*
+	Midpoint of the values recorded in a bucket
+*/
+static unsigned long long acclStatsBucketValue(const unsigned int index) {
+	unsigned int magnitude;
+	unsigned long long low;
+
+	if (index < ACCL_STATS_SUB_BUCKETS)
+		return index;
+
+	magnitude = index / ACCL_STATS_SUB_BUCKETS + ACCL_STATS_SUB_BITS - 1;
+	low = (unsigned long long)(ACCL_STATS_SUB_BUCKETS + index % ACCL_STATS_SUB_BUCKETS)
+		<< (magnitude - ACCL_STATS_SUB_BITS);
+
+	return low + ((1ULL << (magnitude - ACCL_STATS_SUB_BITS)) >> 1);
+}
+
+static unsigned int acclStatsErrorSlot(const int error) {
+	unsigned int i;
+
+	for (i = 0; i < ACCL_STATS_ERROR_SLOTS - 1; i++) {
+		if (stats_error_codes[i] == error)
+			return i;
+	}
+
+	return ACCL_STATS_ERROR_SLOTS - 1;
+}
+
+/*
+	Counters of the calling thread for a technique; slots are claimed
+	lock-free (open addressing, never released)
+*/
+static accl_stats_counters* acclStatsCounters(accl_stats_technique* techniques, const int T_ID) {
+	accl_stats_technique* slot;
+	accl_stats_counters* shards;
+	int expected;
+	unsigned int i;
+
+	if (stats_shard < 0)
+		stats_shard = (int)(__atomic_fetch_add(&stats_next_shard, 1, __ATOMIC_RELAXED) % ACCL_STATS_SHARDS);
+
+	for (i = 0; i < ACCL_STATS_MAX_TECHNIQUES; i++) {
+		slot = &techniques[((unsigned int)T_ID + i) % ACCL_STATS_MAX_TECHNIQUES];
+		expected = __atomic_load_n(&slot->technique_id, __ATOMIC_ACQUIRE);
+
+		// on a lost race expected holds the winner
+		if (0 == expected && __atomic_compare_exchange_n(&slot->technique_id, &expected, T_ID,
+				0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			expected = T_ID;
+
+		if (expected != T_ID)
+			continue;
+
+		shards = __atomic_load_n(&slot->shards, __ATOMIC_ACQUIRE);
+
+		if (NULL == shards) {
+			accl_stats_counters* fresh = NULL;
+
+			if (0 != posix_memalign((void**)&fresh, 64, sizeof(accl_stats_counters) * ACCL_STATS_SHARDS))
+				return NULL;
+
+			memset(fresh, 0, sizeof(accl_stats_counters) * ACCL_STATS_SHARDS);
+
+			if (__atomic_compare_exchange_n(&slot->shards, &shards, fresh,
+					0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				shards = fresh;
+			else
+				free(fresh);
+		}
+
+		return &shards[stats_shard];
+	}
+
+	// table full: the technique goes untracked
+	return NULL;
+}
+
+/*
+	Accounts one completed call
+*/
+static void acclStatsRecord(accl_stats_technique* techniques, const int T_ID, const int error,
+	const unsigned long long started, const unsigned long long sent, const unsigned long long received) {
+
+	accl_stats_counters* counters = acclStatsCounters(techniques, T_ID);
+	unsigned long long latency = acclNow() - started;
+	unsigned long long max;
+
+	if (NULL == counters)
+		return;
+
+	__atomic_fetch_add(&counters->calls, 1, __ATOMIC_RELAXED);
+
+	if (ACCL_SUCCESS != error)
+		__atomic_fetch_add(&counters->errors, 1, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&counters->error_codes[acclStatsErrorSlot(error)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->bytes_sent, sent, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->bytes_received, received, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->latency_sum, latency, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&counters->latency[acclStatsBucket(latency)], 1, __ATOMIC_RELAXED);
+
+	max = __atomic_load_n(&counters->latency_max, __ATOMIC_RELAXED);
+
+	while (latency > max && !__atomic_compare_exchange_n(&counters->latency_max, &max, latency,
+			1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+/*
+	Accounts a retry (hedged: a hedged request) of a call in progress
+*/
+static void acclStatsRetry(accl_stats_technique* techniques, const int T_ID, const int hedged) {
+	accl_stats_counters* counters = acclStatsCounters(techniques, T_ID);
+
+	if (NULL == counters)
+		return;
+
+	if (hedged)
+		__atomic_fetch_add(&counters->hedges, 1, __ATOMIC_RELAXED);
+	else
+		__atomic_fetch_add(&counters->retries, 1, __ATOMIC_RELAXED);
+}
+
+/*
+	Merges the shards of a technique (or all of them, T_ID 0) into a
+	single set of counters
+*/
+static void acclStatsMerge(accl_stats_technique* techniques, const int T_ID, accl_stats_counters* merged) {
+	accl_stats_counters* shards;
+	accl_stats_counters* shard;
+	unsigned long long value;
+	unsigned int i, s, b;
+
+	memset(merged, 0, sizeof(accl_stats_counters));
+
+	for (i = 0; i < ACCL_STATS_MAX_TECHNIQUES; i++) {
+		if (0 != T_ID && __atomic_load_n(&techniques[i].technique_id, __ATOMIC_ACQUIRE) != T_ID)
+			continue;
+
+		shards = __atomic_load_n(&techniques[i].shards, __ATOMIC_ACQUIRE);
+
+		if (NULL == shards)
+			continue;
+
+		for (s = 0; s < ACCL_STATS_SHARDS; s++) {
+			shard = &shards[s];
+
+			merged->calls += __atomic_load_n(&shard->calls, __ATOMIC_RELAXED);
+			merged->errors += __atomic_load_n(&shard->errors, __ATOMIC_RELAXED);
+			merged->retries += __atomic_load_n(&shard->retries, __ATOMIC_RELAXED);
+			merged->hedges += __atomic_load_n(&shard->hedges, __ATOMIC_RELAXED);
+			merged->bytes_sent += __atomic_load_n(&shard->bytes_sent, __ATOMIC_RELAXED);
+			merged->bytes_received += __atomic_load_n(&shard->bytes_received, __ATOMIC_RELAXED);
+			merged->latency_sum += __atomic_load_n(&shard->latency_sum, __ATOMIC_RELAXED);
+
+			value = __atomic_load_n(&shard->latency_max, __ATOMIC_RELAXED);
+			if (value > merged->latency_max)
+				merged->latency_max = value;
+
+			for (b = 0; b < ACCL_STATS_ERROR_SLOTS; b++)
+				merged->error_codes[b] += __atomic_load_n(&shard->error_codes[b], __ATOMIC_RELAXED);
+
+			for (b = 0; b < ACCL_STATS_BUCKETS; b++)
+				merged->latency[b] += __atomic_load_n(&shard->latency[b], __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static unsigned long long acclStatsPercentile(const accl_stats_counters* merged,
+	const unsigned long long samples, const double quantile) {
+
+	unsigned long long rank = (unsigned long long)(quantile * (double)samples);
+	unsigned long long seen = 0;
+	unsigned int b;
+
+	if (0 == samples)
+		return 0;
+
+	if (rank >= samples)
+		rank = samples - 1;
+
+	for (b = 0; b < ACCL_STATS_BUCKETS; b++) {
+		seen += merged->latency[b];
+
+		if (seen > rank)
+			return MIN(acclStatsBucketValue(b), merged->latency_max);
+	}
+
+	return merged->latency_max;
+}
+
+/*
+	Latency quantile of a technique, 0 until minimum calls have been seen
+*/
+static unsigned long long acclStatsQuantile(accl_stats_technique* techniques, const int T_ID,
+	const double quantile, const unsigned long long minimum) {
+
+	accl_stats_counters* merged;
+	unsigned long long samples = 0;
+	unsigned long long value = 0;
+	unsigned int b;
+
+	merged = (accl_stats_counters*)malloc(sizeof(accl_stats_counters));
+
+	if (NULL == merged)
+		return 0;
+
+	acclStatsMerge(techniques, T_ID, merged);
+
+	for (b = 0; b < ACCL_STATS_BUCKETS; b++)
+		samples += merged->latency[b];
+
+	if (samples >= minimum)
+		value = acclStatsPercentile(merged, samples, quantile);
+
+	free(merged);
+
+	return value;
+}
+
+static int acclStatsRead(accl_stats_technique* techniques, const int T_ID, accl_stats* stats) {
+	accl_stats_counters* merged;
+	unsigned long long samples = 0;
+	unsigned int b;
+
+	if (NULL == stats)
+		return ACCL_INPUT_BUFFER_ERROR;
+
+	merged = (accl_stats_counters*)malloc(sizeof(accl_stats_counters));
+
+	if (NULL == merged)
+		return ACCL_GENERIC_ERROR;
+
+	acclStatsMerge(techniques, T_ID, merged);
+
+	// the histogram is read after the call counters: count what it holds
+	for (b = 0; b < ACCL_STATS_BUCKETS; b++)
+		samples += merged->latency[b];
+
+	memset(stats, 0, sizeof(accl_stats));
+
+	stats->technique_id = T_ID;
+	stats->calls = merged->calls;
+	stats->errors = merged->errors;
+	stats->retries = merged->retries;
+	stats->hedges = merged->hedges;
+	stats->bytes_sent = merged->bytes_sent;
+	stats->bytes_received = merged->bytes_received;
+	stats->latency_mean = (samples > 0) ? merged->latency_sum / samples : 0;
+	stats->latency_p50 = acclStatsPercentile(merged, samples, 0.5);
+	stats->latency_p90 = acclStatsPercentile(merged, samples, 0.9);
+	stats->latency_p99 = acclStatsPercentile(merged, samples, 0.99);
+	stats->latency_p999 = acclStatsPercentile(merged, samples, 0.999);
+	stats->latency_max = merged->latency_max;
+
+	for (b = 0; b < ACCL_STATS_ERROR_SLOTS; b++) {
+		stats->error_codes[b].code = stats_error_codes[b];
+		stats->error_codes[b].count = merged->error_codes[b];
+	}
+
+	free(merged);
+
+	return ACCL_SUCCESS;
+}
+
+/*
+	Appends one line per tracked technique to path
+*/
+static int acclStatsWrite(accl_stats_technique* techniques, const char* path) {
+	accl_stats stats;
+	char timestamp[64];
+	time_t now = time(NULL);
+	struct tm local_time;
+	FILE* file;
+	int technique_id;
+	unsigned int i, b;
+
+	file = fopen(path, "a");
+
+	if (NULL == file)
+		return ACCL_GENERIC_ERROR;
+
+	localtime_r(&now, &local_time);
+	strftime(timestamp, sizeof(timestamp), "%a %b %d %H:%M:%S %Y", &local_time);
+
+	for (i = 0; i < ACCL_STATS_MAX_TECHNIQUES; i++) {
+		technique_id = __atomic_load_n(&techniques[i].technique_id, __ATOMIC_ACQUIRE);
+
+		if (0 == technique_id || ACCL_SUCCESS != acclStatsRead(techniques, technique_id, &stats))
+			continue;
+
+		fprintf(file, "%s [acclStats] T_ID=%d calls=%llu errors=%llu retries=%llu hedges=%llu sent=%llu received=%llu"
+			" mean=%lluus p50=%lluus p90=%lluus p99=%lluus p999=%lluus max=%lluus",
+			timestamp, technique_id, stats.calls, stats.errors, stats.retries, stats.hedges,
+			stats.bytes_sent, stats.bytes_received, stats.latency_mean,
+			stats.latency_p50, stats.latency_p90, stats.latency_p99,
+			stats.latency_p999, stats.latency_max);
+
+		for (b = 1; b < ACCL_STATS_ERROR_SLOTS; b++) {
+			if (stats.error_codes[b].count > 0)
+				fprintf(file, " err%d=%llu", stats.error_codes[b].code, stats.error_codes[b].count);
+		}
+
+		fputc('\n', file);
+	}
+
+	fclose(file);
+
+	return ACCL_SUCCESS;
+}
+
+/*
+	Releases the counters of every technique
+*/
+static void acclStatsDestroy(accl_stats_technique* techniques) {
+	unsigned int i;
+
+	for (i = 0; i < ACCL_STATS_MAX_TECHNIQUES; i++)
+		free(techniques[i].shards);
+}
+
+static void acclStatsDumperInit(accl_stats_dumper* dumper, accl_stats_technique* techniques) {
+	memset(dumper, 0, sizeof(accl_stats_dumper));
+
+	pthread_mutex_init(&dumper->mutex, NULL);
+	pthread_cond_init(&dumper->wakeup, NULL);
+	dumper->techniques = techniques;
+}
+
+/*
+	Periodic dump thread
+*/
+static void* acclStatsDumpLoop(void* arg) {
+	accl_stats_dumper* dumper = (accl_stats_dumper*)arg;
+	struct timespec deadline;
+	char path[1024];
+
+	pthread_mutex_lock(&dumper->mutex);
+
+	while (!dumper->stopping) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += dumper->interval;
+
+		while (!dumper->stopping &&
+				ETIMEDOUT != pthread_cond_timedwait(&dumper->wakeup, &dumper->mutex, &deadline))
+			;
+
+		if (dumper->stopping)
+			break;
+
+		strcpy(path, dumper->path);
+
+		pthread_mutex_unlock(&dumper->mutex);
+		acclStatsWrite(dumper->techniques, path);
+		pthread_mutex_lock(&dumper->mutex);
+	}
+
+	pthread_mutex_unlock(&dumper->mutex);
+
+	return NULL;
+}
+
+static int acclStatsDumpStart(accl_stats_dumper* dumper, const char* path, const unsigned int interval) {
+	int returnValue = ACCL_SUCCESS;
+
+	if (NULL == path || strlen(path) >= sizeof(dumper->path))
+		return ACCL_INPUT_BUFFER_ERROR;
+
+	if (0 == interval)
+		return acclStatsWrite(dumper->techniques, path);
+
+	pthread_mutex_lock(&dumper->mutex);
+
+	strcpy(dumper->path, path);
+	dumper->interval = interval;
+
+	if (!dumper->running) {
+		if (0 == pthread_create(&dumper->thread, NULL, acclStatsDumpLoop, dumper))
+			dumper->running = 1;
+		else
+			returnValue = ACCL_GENERIC_ERROR;
+	}
+
+	pthread_mutex_unlock(&dumper->mutex);
+
+	return returnValue;
+}
+
+static void acclStatsDumperDestroy(accl_stats_dumper* dumper) {
+	pthread_mutex_lock(&dumper->mutex);
+	dumper->stopping = 1;
+	pthread_cond_signal(&dumper->wakeup);
+	pthread_mutex_unlock(&dumper->mutex);
+
+	if (dumper->running)
+		pthread_join(dumper->thread, NULL);
+
+	pthread_cond_destroy(&dumper->wakeup);
+	pthread_mutex_destroy(&dumper->mutex);
+}
+
+/*
+	ACCL retry policies
+	opt-in per technique: failed requests are sent again after an
+	exponential backoff with full jitter; the hedge delay of idempotent
+	exchanges tracks the latency quantile observed by the metrics
+*/
+typedef struct accl_retry_policy {
+	int technique_id;
+	unsigned int attempts;					/* 1: no retries */
+	unsigned int backoff;					/* first retry delay, ms */
+	unsigned int max_backoff;				/* retry delay cap, ms */
+	int flags;								/* ACCL_RETRY_* */
+	int inherited;							/* copied from the technique registry */
+	unsigned long long hedge_delay;			/* microseconds, 0: not known yet */
+	unsigned long long hedge_updated;		/* acclNow() of the last refresh */
+} accl_retry_policy;
+
+typedef struct accl_retry {
+	pthread_mutex_t mutex;					/* protects everything below */
+	accl_retry_policy policies[ACCL_RETRY_MAX_TECHNIQUES];
+	int policy_count;
+} accl_retry;
+
+static __thread unsigned int retry_seed = 0;
+
+static void acclRetryInit(accl_retry* retry) {
+	memset(retry, 0, sizeof(accl_retry));
+
+	pthread_mutex_init(&retry->mutex, NULL);
+}
+
+static void acclRetryDestroy(accl_retry* retry) {
+	pthread_mutex_destroy(&retry->mutex);
+}
+
+/*
+	Copies the policy of a technique, 0 when it has none; techniques the
+	client did not configure follow the registry, their entry only keeps
+	the hedge state; the hedge delay is refreshed from the metrics at most
+	every ACCL_HEDGE_REFRESH ms
+*/
+static int acclRetryLookup(accl_retry* retry, accl_stats_technique* techniques, const accl_technique* technique, accl_retry_policy* policy) {
+	const int T_ID = technique->technique_id;
+	int inherit = (technique->retry_attempts > 1 || 0 != technique->retry_flags);
+	unsigned long long now;
+	int found = 0;
+	int i;
+
+	// fast path: no technique opted in
+	if (!inherit && 0 == __atomic_load_n(&retry->policy_count, __ATOMIC_ACQUIRE))
+		return 0;
+
+	pthread_mutex_lock(&retry->mutex);
+	for (i = 0; i < retry->policy_count; i++) {
+		if (retry->policies[i].technique_id == T_ID)
+			break;
+	}
+
+	if (i < retry->policy_count ? retry->policies[i].inherited : (inherit && i < ACCL_RETRY_MAX_TECHNIQUES)) {
+		retry->policies[i].technique_id = T_ID;
+		retry->policies[i].attempts = technique->retry_attempts;
+		retry->policies[i].backoff = technique->retry_backoff;
+		retry->policies[i].max_backoff = technique->retry_max_backoff;
+		retry->policies[i].flags = technique->retry_flags;
+		retry->policies[i].inherited = 1;
+
+		if (i == retry->policy_count)
+			__atomic_store_n(&retry->policy_count, i + 1, __ATOMIC_RELEASE);
+	}
+
+	if (i < retry->policy_count) {
+		*policy = retry->policies[i];
+		found = 1;
+	}
+	pthread_mutex_unlock(&retry->mutex);
+
+	if (!found || !(policy->flags & ACCL_RETRY_HEDGE))
+		return found;
+
+	now = acclNow();
+
+	if (now - policy->hedge_updated >= (unsigned long long)ACCL_HEDGE_REFRESH * 1000) {
+		policy->hedge_delay = acclStatsQuantile(techniques, T_ID, ACCL_HEDGE_QUANTILE, ACCL_HEDGE_MIN_SAMPLES);
+		policy->hedge_updated = now;
+
+		pthread_mutex_lock(&retry->mutex);
+		retry->policies[i].hedge_delay = policy->hedge_delay;
+		retry->policies[i].hedge_updated = now;
+		pthread_mutex_unlock(&retry->mutex);
+	}
+
+	return found;
+}
+
+/*
+	Delay before retry number attempt (1 based): uniformly distributed up
+	to the exponential backoff, so that clients failing together do not
+	come back together
+*/
+static unsigned int acclRetryBackoff(const accl_retry_policy* policy, const unsigned int attempt) {
+	unsigned long long ceiling = policy->backoff;
+	unsigned int i;
+
+	for (i = 1; i < attempt && ceiling < policy->max_backoff; i++)
+		ceiling <<= 1;
+
+	ceiling = MIN(ceiling, (unsigned long long)policy->max_backoff);
+
+	if (0 == retry_seed)
+		retry_seed = (unsigned int)acclNow() ^ (unsigned int)(uintptr_t)&retry_seed;
+
+	return (0 == ceiling) ? 0 : (unsigned int)(rand_r(&retry_seed) % (ceiling + 1));
+}
+
+static int acclRetrySetPolicy(accl_retry* retry, const int T_ID, const unsigned int attempts,
+	const unsigned int backoff, const unsigned int maxBackoff, const int flags) {
+
+	int returnValue = ACCL_SUCCESS;
+	int i;
+
+	if (ACCL_SUCCESS != acclCheckTechnique("acclSetRetryPolicy", T_ID, NULL))
+		return ACCL_UNKNOWN_TECHNIQUE_ID;
+
+	pthread_mutex_lock(&retry->mutex);
+
+	for (i = 0; i < retry->policy_count; i++) {
+		if (retry->policies[i].technique_id == T_ID)
+			break;
+	}
+
+	if (i < ACCL_RETRY_MAX_TECHNIQUES) {
+		retry->policies[i].technique_id = T_ID;
+		retry->policies[i].attempts = MAX(attempts, 1);
+		retry->policies[i].backoff = backoff;
+		retry->policies[i].max_backoff = MAX(maxBackoff, backoff);
+		retry->policies[i].flags = flags;
+		retry->policies[i].inherited = 0;
+
+		if (i == retry->policy_count)
+			__atomic_store_n(&retry->policy_count, i + 1, __ATOMIC_RELEASE);
+	} else {
+		returnValue = ACCL_GENERIC_ERROR;
+	}
+
+	pthread_mutex_unlock(&retry->mutex);
+
+	return returnValue;
+}
+
+/*
+	ACCL portal selection
+	the endpoint (and WebSockets host) configuration may list several
+	ASPIRE Portal nodes: each request goes to the healthy node with the
+	fewest requests in flight, or the lowest latency EWMA, and a node
+	refusing connections is failed over at once; a background health
+	check brings nodes back (or takes them out) between requests
+*/
+typedef struct accl_portal {
+	char endpoint[1024];					/* portal URL (WebSockets: host) */
+	unsigned int outstanding;				/* requests (connections) in flight */
+	unsigned long long ewma;				/* latency EWMA in us, 0: no sample yet */
+	unsigned long long down_until;			/* acclNow() before which the node is avoided */
+	int port;								/* WebSockets: port of the last channel established, 0: none */
+} accl_portal;
+
+typedef struct accl_portals {
+	accl_portal nodes[ACCL_MAX_PORTALS];
+	unsigned int count;
+	unsigned int next;						/* rotating start of the selection scan */
+	int balance;							/* ACCL_BALANCE_* */
+	accl_timeouts* timeouts;				/* health check connect timeout */
+	int hosts;								/* WebSockets hosts rather than URLs */
+	pthread_mutex_t mutex;					/* health checker state below */
+	pthread_cond_t wakeup;					/* signalled on stop */
+	int running;
+	int stopping;
+	pthread_t thread;
+} accl_portals;
+
+/*
+	Splits a comma or white space separated list of endpoints
+*/
+static void acclPortalsInit(accl_portals* portals, const char* list, accl_timeouts* timeouts) {
+	const char* separators = " \t\r\n,";
+	size_t length;
+
+	memset(portals, 0, sizeof(accl_portals));
+
+	pthread_mutex_init(&portals->mutex, NULL);
+	pthread_cond_init(&portals->wakeup, NULL);
+	portals->balance = ACCL_BALANCE;
+	portals->timeouts = timeouts;
+
+	list += strspn(list, separators);
+
+	while ('\0' != *list && portals->count < ACCL_MAX_PORTALS) {
+		length = MIN(strcspn(list, separators), sizeof(portals->nodes[0].endpoint) - 1);
+
+		memcpy(portals->nodes[portals->count].endpoint, list, length);
+		portals->nodes[portals->count].endpoint[length] = '\0';
+		portals->count++;
+
+		list += strcspn(list, separators);
+		list += strspn(list, separators);
+	}
+
+	// an empty list still yields a (failing) node
+	if (0 == portals->count)
+		portals->count = 1;
+}
+
+/* n = 0, 1, ... */
+static int acclPortalTried(const unsigned int tried, const unsigned int n) {
+	return 0 != (tried & (1u << n));
+}
+
+/*
+	Node for the next request, skipping the tried ones (bit mask); nodes
+	known to be down are only used when nothing else is left. -1 when
+	every node was tried
+*/
+static int acclPortalPick(accl_portals* portals, const unsigned int tried) {
+	unsigned long long now, score, best_score = 0;
+	unsigned int start, i, n;
+	accl_portal* node;
+	int best = -1;
+	int fallback = -1;
+	int balance;
+
+	if (1 == portals->count)
+		return acclPortalTried(tried, 0) ? -1 : 0;
+
+	now = acclNow();
+	balance = __atomic_load_n(&portals->balance, __ATOMIC_RELAXED);
+
+	// ties go round robin
+	start = __atomic_fetch_add(&portals->next, 1, __ATOMIC_RELAXED);
+
+	for (i = 0; i < portals->count; i++) {
+		n = (start + i) % portals->count;
+		node = &portals->nodes[n];
+
+		if (acclPortalTried(tried, n))
+			continue;
+
+		if (__atomic_load_n(&node->down_until, __ATOMIC_RELAXED) > now) {
+			if (fallback < 0 || node->down_until < portals->nodes[fallback].down_until)
+				fallback = (int)n;
+			continue;
+		}
+
+		// EWMA weighted by the load, so that the fastest node is not flooded
+		if (ACCL_BALANCE_EWMA == balance)
+			score = __atomic_load_n(&node->ewma, __ATOMIC_RELAXED) *
+				(__atomic_load_n(&node->outstanding, __ATOMIC_RELAXED) + 1);
+		else
+			score = __atomic_load_n(&node->outstanding, __ATOMIC_RELAXED);
+
+		if (best < 0 || score < best_score) {
+			best = (int)n;
+			best_score = score;
+		}
+	}
+
+	return (best >= 0) ? best : fallback;
+}
+
+/*
+	Node refusing connections: avoided for ACCL_PORTAL_DOWN_TIME ms or
+	until a health check finds it back
+*/
+static void acclPortalDown(accl_portals* portals, const int n) {
+#ifndef NDEBUG
+	acclLOG("acclPortalDown", "portal %s unreachable", ACCL_LOG_LEVEL_WARNING, portals->nodes[n].endpoint);
+#endif
+	__atomic_store_n(&portals->nodes[n].down_until,
+		acclNow() + (unsigned long long)ACCL_PORTAL_DOWN_TIME * 1000, __ATOMIC_RELAXED);
+}
+
+static void acclPortalAcquire(accl_portals* portals, const int n) {
+	__atomic_fetch_add(&portals->nodes[n].outstanding, 1, __ATOMIC_RELAXED);
+}
+
+/*
+	Accounts the outcome of a request: latency sample, and the node back
+	up, when the portal answered (started 0: no answer); a down period
+	for nodes refusing connections
+*/
+static void acclPortalRelease(accl_portals* portals, const int n, const int failure, const unsigned long long started) {
+	accl_portal* node = &portals->nodes[n];
+	unsigned long long now = acclNow();
+	unsigned long long ewma;
+
+	__atomic_fetch_sub(&node->outstanding, 1, __ATOMIC_RELAXED);
+
+	if (ACCL_FAILURE_UNSENT == failure) {
+		acclPortalDown(portals, n);
+		return;
+	}
+
+	if (0 == started)
+		return;
+
+	// racing updates may lose a sample, which is harmless here
+	ewma = __atomic_load_n(&node->ewma, __ATOMIC_RELAXED);
+	ewma = (0 == ewma) ? now - started : (ewma * (ACCL_PORTAL_EWMA_WEIGHT - 1) + (now - started)) / ACCL_PORTAL_EWMA_WEIGHT;
+	__atomic_store_n(&node->ewma, MAX(ewma, 1ULL), __ATOMIC_RELAXED);
+	__atomic_store_n(&node->down_until, 0, __ATOMIC_RELAXED);
+}
+
+/*
+	Connect-only probe of every node, the verdict holds until the next
+	round or the next request
+*/
+static void acclPortalsProbe(accl_portals* portals) {
+	char url[sizeof(portals->nodes[0].endpoint) + 32];
+	unsigned long long now;
+	unsigned int i;
+	CURLcode res;
+	CURL* curl;
+	int length, port;
+
+	for (i = 0; i < portals->count; i++) {
+		// hosts are probed as plain TCP on a port a channel reached them
+		// on; the others are left to connection failures
+		if (portals->hosts) {
+			port = __atomic_load_n(&portals->nodes[i].port, __ATOMIC_RELAXED);
+
+			if (0 == port)
+				continue;
+
+			length = snprintf(url, sizeof(url), "http://%s:%d/", portals->nodes[i].endpoint, port);
+
+			if (length <= 0 || length >= (int)sizeof(url))
+				continue;
+		}
+
+		curl = curl_easy_init();
+
+		if (NULL == curl)
+			return;
+
+		curl_easy_setopt(curl, CURLOPT_URL, portals->hosts ? url : portals->nodes[i].endpoint);
+		curl_easy_setopt(curl, CURLOPT_CONNECT_ONLY, 1L);
+		curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS,
+			(long)__atomic_load_n(&portals->timeouts->connect, __ATOMIC_RELAXED));
+
+		res = curl_easy_perform(curl);
+		now = acclNow();
+
+		curl_easy_cleanup(curl);
+
+		if (CURLE_OK == res)
+			__atomic_store_n(&portals->nodes[i].down_until, 0, __ATOMIC_RELAXED);
+		else
+			__atomic_store_n(&portals->nodes[i].down_until,
+				now + (unsigned long long)ACCL_PORTAL_DOWN_TIME * 1000, __ATOMIC_RELAXED);
+
+#ifndef NDEBUG
+		acclLOG("acclPortalsProbe", "portal %s %s", ACCL_LOG_LEVEL_DEBUG,
+			portals->nodes[i].endpoint, (CURLE_OK == res) ? "up" : "down");
+#endif
+	}
+}
+
+/*
+	Health check thread
+*/
+static void* acclPortalsCheckLoop(void* arg) {
+	accl_portals* portals = (accl_portals*)arg;
+	struct timespec deadline;
+
+	pthread_mutex_lock(&portals->mutex);
+
+	while (!portals->stopping) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += ACCL_PORTAL_HEALTH_INTERVAL / 1000;
+		deadline.tv_nsec += (long)(ACCL_PORTAL_HEALTH_INTERVAL % 1000) * 1000000L;
+
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		while (!portals->stopping &&
+				ETIMEDOUT != pthread_cond_timedwait(&portals->wakeup, &portals->mutex, &deadline))
+			;
+
+		if (portals->stopping)
+			break;
+
+		pthread_mutex_unlock(&portals->mutex);
+		acclPortalsProbe(portals);
+		pthread_mutex_lock(&portals->mutex);
+	}
+
+	pthread_mutex_unlock(&portals->mutex);
+
+	return NULL;
+}
+
+/*
+	Health checks only make sense with somewhere to fail over to
+*/
+static void acclPortalsCheckStart(accl_portals* portals) {
+	if (portals->count < 2 || 0 == ACCL_PORTAL_HEALTH_INTERVAL)
+		return;
+
+	if (0 == pthread_create(&portals->thread, NULL, acclPortalsCheckLoop, portals))
+		portals->running = 1;
+}
+
+static void acclPortalsDestroy(accl_portals* portals) {
+	pthread_mutex_lock(&portals->mutex);
+	portals->stopping = 1;
+	pthread_cond_signal(&portals->wakeup);
+	pthread_mutex_unlock(&portals->mutex);
+
+	if (portals->running)
+		pthread_join(portals->thread, NULL);
+
+	pthread_cond_destroy(&portals->wakeup);
+	pthread_mutex_destroy(&portals->mutex);
+}
+
+/*
+	ACCL asynchronous exchange engine
+	a single I/O thread per client drives every outstanding
+	acclExchangeAsync request through one cURL multi handle
+*/
+typedef struct accl_async_request {
+	accl_client* client;					/* owning client */
+	CURL* curl;								/* pooled easy handle */
+	accl_iovec segment;						/* contiguous payload */
+	accl_payload_transfer payload;
+	accl_response response;
+	char aspire_portal_uri[1024];
+	accl_exchange_callback callback;		/* completion callback */
+	void* user_data;						/* passed back to the callback */
+	unsigned long long started;				/* submission time (metrics) */
+	unsigned long long sent;				/* current attempt start (portal EWMA) */
+	int portal;								/* portal node of the current attempt */
+	unsigned int tried;						/* portal nodes tried (bit mask) */
+	int priority;							/* ACCL_PRIORITY_* of the technique */
+	struct accl_async_request* next;		/* submission queue link */
+} accl_async_request;
+
+typedef struct accl_async_engine {
+	pthread_mutex_t mutex;					/* protects everything below */
+	accl_async_request* head[ACCL_PRIORITY_INTERACTIVE + 1];	/* submitted, not yet in the multi handle */
+	accl_async_request* tail[ACCL_PRIORITY_INTERACTIVE + 1];	/* (one queue per priority class) */
+	unsigned int background;				/* background requests in flight (I/O thread only) */
+	CURLM* multi;
+	pthread_t thread;						/* I/O thread */
+	int started;							/* I/O thread running */
+	int stopping;							/* no more submissions, drain and exit */
+	int error;								/* initialization outcome */
+} accl_async_engine;
+
+/*
+	ACCL warm-up
+	DNS answers, keep-alive connections and WebSockets channels are set up
+	ahead of the first request, optionally from a background thread;
+	channels wait in the client until acclWebSocketInit claims them
+*/
+typedef struct accl_warmup {
+	pthread_mutex_t mutex;					/* protects everything below */
+	pthread_t thread;						/* background warm-up */
+	int running;							/* thread to be joined */
+	int techniques[ACCL_WARMUP_MAX_CHANNELS];	/* background warm-up channels */
+	unsigned int technique_count;
+#ifndef WITHOUT_WEBSOCKETS
+	struct {
+		int technique_id;					/* 0: free slot */
+		struct libwebsocket_context* context;
+	} channels[ACCL_WARMUP_MAX_CHANNELS];	/* opened, not claimed yet */
+#endif
+} accl_warmup;
+
+#ifndef WITHOUT_WEBSOCKETS
+/*
+	ACCL WebSockets service
+	one libwebsockets context per client, serviced by one thread: every
+	technique channel is a connection of that context, registered in the
+	channel table until it is freed
+*/
+typedef struct accl_ws_service {
+	pthread_mutex_t mutex;					/* protects everything below */
+	struct libwebsocket_context* context;	/* NULL until the first channel */
+	struct libwebsocket_protocols protocols[ACCL_WS_PROTOCOL_COUNT + 1];
+	pthread_t thread;
+	int stopping;
+	struct accl_context_buffer* channels[ACCL_MAX_WS_THREADS];
+	unsigned int channel_count;
+} accl_ws_service;
+#endif
+
+/*
+	ACCL client
+	everything a portal connection needs: configuration resolved once at
+	creation, connection pool, I/O thread, cache, compression state and
+	metrics; the legacy API uses a process wide default client
+*/
+struct accl_client {
+	accl_portals portals;					/* ASPIRE Portal URLs */
+	char application_id[1024];
+	accl_portals ws_portals;				/* WebSockets hosts */
+	accl_http_pool http_pool;
+	accl_timeouts timeouts;
+	accl_retry retry;
+	accl_compression compression;
+	accl_cache cache;
+	accl_stats_technique stats[ACCL_STATS_MAX_TECHNIQUES];
+	accl_stats_dumper stats_dumper;
+	accl_async_engine async_engine;
+	accl_warmup warmup;
+#ifndef WITHOUT_WEBSOCKETS
+	accl_ws_service ws_service;
+#endif
+};
+
+static accl_client default_client;
+static pthread_once_t default_client_once = PTHREAD_ONCE_INIT;
+
+static void acclAsyncShutdown(accl_client* client);
+static void acclWarmupDestroy(accl_client* client);
+#ifndef WITHOUT_WEBSOCKETS
+static void acclWebSocketServiceDestroy(accl_client* client);
+static struct accl_context_buffer* acclWebSocketChannel(struct libwebsocket_context* context);
+int acclGetWebSocketPort(int technique_id);
+#endif
+
+/*
+	Client initialization; NULL settings are resolved as the legacy API
+	always did (ACCL_FILE_PATH files, then compile time defaults)
+*/
+static void acclClientInit(accl_client* client, const char* endpoint, const char* applicationId, const char* wsHost) {
+	char* app_start_address = client->application_id;
+	char list[ACCL_MAX_PORTALS * 1024];
+
+	memset(client, 0, sizeof(accl_client));
+
+	acclTimeoutsInit(&client->timeouts);
+
+	if (NULL == endpoint)
+		acclConfigEndpoint(list, sizeof(list));
+
+	acclPortalsInit(&client->portals, (NULL != endpoint) ? endpoint : list, &client->timeouts);
+
+	if (NULL != applicationId)
+		strncpy(client->application_id, applicationId, sizeof(client->application_id) - 1);
+	else
+		getApplicationId(&app_start_address);
+
+#ifndef WITHOUT_WEBSOCKETS
+	if (NULL == wsHost)
+		acclConfigWebSocketHost(list, sizeof(list));
+
+	acclPortalsInit(&client->ws_portals, (NULL != wsHost) ? wsHost : list, &client->timeouts);
+	client->ws_portals.hosts = 1;
+#else
+	acclPortalsInit(&client->ws_portals, "", &client->timeouts);
+#endif
+
+	acclHttpPoolInit(&client->http_pool);
+	acclRetryInit(&client->retry);
+	acclCompressionInit(&client->compression);
+	acclCacheInit(&client->cache);
+	acclStatsDumperInit(&client->stats_dumper, client->stats);
+
+	pthread_mutex_init(&client->async_engine.mutex, NULL);
+	pthread_mutex_init(&client->warmup.mutex, NULL);
+#ifndef WITHOUT_WEBSOCKETS
+	pthread_mutex_init(&client->ws_service.mutex, NULL);
+#endif
+
+	acclPortalsCheckStart(&client->portals);
+	acclPortalsCheckStart(&client->ws_portals);
+}
+
+static void acclDefaultClientInit(void) {
+	acclClientInit(&default_client, NULL, NULL, NULL);
+}
+
+/*
+	Client of the legacy (client-less) API
+*/
+static accl_client* acclDefaultClient(void) {
+	pthread_once(&default_client_once, acclDefaultClientInit);
+
+	return &default_client;
+}
+
+accl_client* acclClientCreate(const char* endpoint, const char* applicationId, const char* wsHost) {
+	accl_client* client = (accl_client*)malloc(sizeof(accl_client));
+
+	if (NULL == client)
+		return NULL;
+
+	acclClientInit(client, endpoint, applicationId, wsHost);
+
+	if (client->http_pool.error != ACCL_SUCCESS) {
+#ifndef NDEBUG
+		acclLOG("acclClientCreate", "HTTP pool initialization failed (%d)",
+			ACCL_LOG_LEVEL_ERROR, client->http_pool.error);
+#endif
+		acclClientDestroy(client);
+		return NULL;
+	}
+
+	return client;
+}
+
+int acclClientDestroy(accl_client* client) {
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	// the default client lives as long as the process
+	if (&default_client == client)
+		return ACCL_SUCCESS;
+
+	acclWarmupDestroy(client);
+#ifndef WITHOUT_WEBSOCKETS
+	acclWebSocketServiceDestroy(client);
+#endif
+	acclStatsDumperDestroy(&client->stats_dumper);
+	acclAsyncShutdown(client);
+	acclPortalsDestroy(&client->portals);
+	acclPortalsDestroy(&client->ws_portals);
+	acclHttpPoolDestroy(&client->http_pool);
+	acclCacheDestroy(&client->cache);
+	acclRetryDestroy(&client->retry);
+	acclStatsDestroy(client->stats);
+
+	pthread_mutex_destroy(&client->async_engine.mutex);
+
+	free(client);
+
+	return ACCL_SUCCESS;
+}
+
+int acclClientSetCompression(accl_client* client, const int enabled, const unsigned int threshold) {
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	__atomic_store_n(&client->compression.threshold, threshold, __ATOMIC_RELAXED);
+	__atomic_store_n(&client->compression.enabled, enabled, __ATOMIC_RELAXED);
+
+	return ACCL_SUCCESS;
+}
+
+void acclSetCompression(const int enabled, const unsigned int threshold) {
+	acclClientSetCompression(acclDefaultClient(), enabled, threshold);
+}
+
+int acclClientSetTimeouts(accl_client* client, const unsigned int connectTimeout, const unsigned int totalTimeout,
+	const unsigned int lowSpeedLimit, const unsigned int lowSpeedTime) {
+
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	__atomic_store_n(&client->timeouts.connect, connectTimeout, __ATOMIC_RELAXED);
+	__atomic_store_n(&client->timeouts.total, totalTimeout, __ATOMIC_RELAXED);
+	__atomic_store_n(&client->timeouts.low_speed_limit, lowSpeedLimit, __ATOMIC_RELAXED);
+	__atomic_store_n(&client->timeouts.low_speed_time, lowSpeedTime, __ATOMIC_RELAXED);
+
+	return ACCL_SUCCESS;
+}
+
+void acclSetTimeouts(const unsigned int connectTimeout, const unsigned int totalTimeout,
+	const unsigned int lowSpeedLimit, const unsigned int lowSpeedTime) {
+
+	acclClientSetTimeouts(acclDefaultClient(), connectTimeout, totalTimeout, lowSpeedLimit, lowSpeedTime);
+}
+
+int acclClientSetBalancing(accl_client* client, const int policy) {
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	if (ACCL_BALANCE_LEAST_OUTSTANDING != policy && ACCL_BALANCE_EWMA != policy)
+		return ACCL_GENERIC_ERROR;
+
+	__atomic_store_n(&client->portals.balance, policy, __ATOMIC_RELAXED);
+
+	return ACCL_SUCCESS;
+}
+
+int acclSetBalancing(const int policy) {
+	return acclClientSetBalancing(acclDefaultClient(), policy);
+}
+
+int acclClientSetRetryPolicy(accl_client* client, const int T_ID, const unsigned int attempts,
+	const unsigned int backoff, const unsigned int maxBackoff, const int flags) {
+
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	return acclRetrySetPolicy(&client->retry, T_ID, attempts, backoff, maxBackoff, flags);
+}
+
+int acclSetRetryPolicy(const int T_ID, const unsigned int attempts, const unsigned int backoff,
+	const unsigned int maxBackoff, const int flags) {
+
+	return acclClientSetRetryPolicy(acclDefaultClient(), T_ID, attempts, backoff, maxBackoff, flags);
+}
+
+int acclClientCacheEnable(accl_client* client, const int T_ID, const unsigned int ttl) {
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	return acclCachePolicy(&client->cache, T_ID, ttl);
+}
+
+int acclCacheEnable(const int T_ID, const unsigned int ttl) {
+	return acclClientCacheEnable(acclDefaultClient(), T_ID, ttl);
+}
+
+int acclClientCacheConfigure(accl_client* client, const unsigned int memoryBudget, const char* diskPath) {
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	return acclCacheLimits(&client->cache, memoryBudget, diskPath);
+}
+
+int acclCacheConfigure(const unsigned int memoryBudget, const char* diskPath) {
+	return acclClientCacheConfigure(acclDefaultClient(), memoryBudget, diskPath);
+}
+
+int acclClientGetStats(accl_client* client, const int T_ID, accl_stats* stats) {
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	return acclStatsRead(client->stats, T_ID, stats);
+}
+
+int acclGetStats(const int T_ID, accl_stats* stats) {
+	return acclClientGetStats(acclDefaultClient(), T_ID, stats);
+}
+
+int acclClientStatsDump(accl_client* client, const char* path, const unsigned int interval) {
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	return acclStatsDumpStart(&client->stats_dumper, path, interval);
+}
+
+int acclStatsDump(const char* path, const unsigned int interval) {
+	return acclClientStatsDump(acclDefaultClient(), path, interval);
+}
+
+/*
+	Hands a response that did not come from the network to the caller
+	according to the response mode (allocated, caller buffer or stream);
+	the data buffer is consumed
+*/
+static int acclResponseDeliver(accl_response* response, char* data, unsigned int size) {
+	int returnValue = ACCL_SUCCESS;
+
+	if (NULL != response->stream_callback) {
+		if (size > 0 && 0 != response->stream_callback(data, size, response->stream_user_data))
+			returnValue = ACCL_STREAM_ABORTED;
+		else
+			response->output_buffer_size = size;
+	} else if (response->external_buffer) {
+		if (size > response->output_buffer_capacity) {
+			returnValue = ACCL_OUTPUT_BUFFER_MAX_SIZE_EXCEEDED;
+		} else {
+			memcpy(response->output_buffer, data, size);
+			response->output_buffer_size = size;
+		}
+	} else {
+		// ownership goes to the caller
+		response->output_buffer = data;
+		response->output_buffer_size = size;
+		return ACCL_SUCCESS;
+	}
+
+	free(data);
+
+	return returnValue;
+}
+
+/*
+	Empties a response before the request is sent again
+*/
+static void acclResponseRewind(accl_response* response) {
+	if (NULL == response)
+		return;
+
+	response->output_buffer_size = 0;
+	response->error = ACCL_SUCCESS;
+}
+
+/*
+	Request URI on portal node n, ACCL_GENERIC_ERROR when it does not fit
+	in size bytes
+*/
+static int acclHttpUri(accl_client* client, char* uri, const size_t size, const int n, const char* type, const int T_ID) {
+	int length;
+
+	// requests to ASPIRE Portal include
+	// 	- endpoint (ASPIRE Portal URL)
+	//	- request type (exchange | send)
+	//	- technique ID
+	//	- application ID
+	length = snprintf(uri, size, "%s/%s/%d/%s", client->portals.nodes[n].endpoint, type, T_ID, client->application_id);
+
+	if (length < 0 || (size_t)length >= size) {
+#ifndef NDEBUG
+		acclLOG("acclHttpUri", "request URI longer than %d bytes", ACCL_LOG_LEVEL_ERROR, (int)size - 1);
+#endif
+		return ACCL_GENERIC_ERROR;
+	}
+
+	return ACCL_SUCCESS;
+}
+
+/*
+	Synchronous request shared by the exchange and send primitives
+	(response is NULL for send requests); a portal node refusing the
+	connection is failed over to the next one straight away, within
+	the same call deadline
+*/
+static int acclHttpPerform(
+	accl_client* client,
+	const char* tag,
+	accl_payload_transfer* payload,
+	accl_response* response) {
+
+	CURL *curl;
+  	CURLcode res;
+  	char aspire_portal_uri[1024];
+  	accl_payload_transfer initial = *payload;
+  	unsigned long long began = acclNow();
+  	unsigned long long started;
+  	unsigned long long elapsed = 0;
+  	unsigned int tried = 0;
+  	int returnValue;
+  	int portal;
+
+	// pooled handle (cURL is initialized once per process)
+	curl = acclHttpAcquire(&client->http_pool);
+
+	if (NULL == curl)
+		return ACCL_CURL_INITIALIZATION_ERROR;
+
+	portal = acclPortalPick(&client->portals, tried);
+
+	for (;;) {
+		tried |= 1u << portal;
+
+		returnValue = acclHttpUri(client, aspire_portal_uri, sizeof(aspire_portal_uri), portal,
+			(NULL != response) ? "exchange" : "send", payload->technique_id);
+
+		if (ACCL_SUCCESS != returnValue)
+			break;
+
+		acclHttpSetup(curl, &client->http_pool, &client->timeouts, &client->compression, aspire_portal_uri, payload, response);
+
+		acclPortalAcquire(&client->portals, portal);
+		started = acclNow();
+
+		// Perform the request, res will get the return code
+		res = curl_easy_perform(curl);
+
+		returnValue = acclHttpResult(tag, curl, res, payload, response);
+
+		acclPortalRelease(&client->portals, portal, payload->failure, payload->answered ? started : 0);
+
+		acclCompressionSample(&client->compression, curl);
+
+		acclPayloadRelease(payload);
+
+		if (payload->failure != ACCL_FAILURE_UNSENT)
+			break;
+
+		// all nodes share the call deadline
+		if (initial.timeout > 0) {
+			elapsed = (acclNow() - began) / 1000;
+
+			if (elapsed >= initial.timeout)
+				break;
+		}
+
+		portal = acclPortalPick(&client->portals, tried);
+
+		if (portal < 0)
+			break;
+
+#ifndef NDEBUG
+		acclLOG(tag, "failing over to %s", ACCL_LOG_LEVEL_WARNING, client->portals.nodes[portal].endpoint);
+#endif
+
+		// same request from scratch, on a clean handle
+		curl_easy_reset(curl);
+		*payload = initial;
+		if (initial.timeout > 0)
+			payload->timeout = initial.timeout - (unsigned int)elapsed;
+		acclResponseRewind(response);
+	}
+
+	// handle goes back to the pool on every path
+	acclHttpRelease(&client->http_pool, curl);
+
+	return returnValue;
+}
+
+/*
+	Hedged variant of acclHttpPerform: a second copy of the request is
+	sent when the first has not completed after delay microseconds, the
+	first successful response is kept and the other transfer abandoned
+*/
+static int acclHttpHedge(
+	accl_client* client,
+	const char* tag,
+	accl_payload_transfer* payload,
+	accl_response* response,
+	const unsigned long long delay) {
+
+	CURLM* multi;
+	CURLMsg* message;
+	CURL* curl[2] = { NULL, NULL };
+	accl_payload_transfer hedge_payload = *payload;
+	accl_response hedge_response;
+	accl_payload_transfer* payloads[2] = { payload, &hedge_payload };
+	accl_response* responses[2] = { response, &hedge_response };
+	int results[2] = { ACCL_GENERIC_ERROR, ACCL_GENERIC_ERROR };
+	char aspire_portal_uri[1024];
+	unsigned long long started = acclNow();
+	unsigned long long elapsed;
+	unsigned long long launched[2] = { 0, 0 };
+	int portals[2] = { -1, -1 };
+	int winner = -1;
+	int active = 0;
+	int hedge = 1;
+	int running, queued, i;
+
+	portals[0] = acclPortalPick(&client->portals, 0);
+
+	if (ACCL_SUCCESS != acclHttpUri(client, aspire_portal_uri, sizeof(aspire_portal_uri), portals[0],
+			"exchange", payload->technique_id))
+		return ACCL_GENERIC_ERROR;
+
+	multi = curl_multi_init();
+	curl[0] = acclHttpAcquire(&client->http_pool);
+
+	if (NULL == multi || NULL == curl[0]) {
+		if (NULL != curl[0])
+			acclHttpRelease(&client->http_pool, curl[0]);
+		if (NULL != multi)
+			curl_multi_cleanup(multi);
+
+		return ACCL_CURL_INITIALIZATION_ERROR;
+	}
+
+	// the hedged copy always gets a buffer of its own
+	acclResponseInit(&hedge_response, NULL, 0);
+
+	acclHttpSetup(curl[0], &client->http_pool, &client->timeouts, &client->compression, aspire_portal_uri, payload, response);
+	curl_multi_add_handle(multi, curl[0]);
+	acclPortalAcquire(&client->portals, portals[0]);
+	launched[0] = started;
+	active++;
+
+	while (active > 0) {
+		curl_multi_perform(multi, &running);
+
+		while (NULL != (message = curl_multi_info_read(multi, &queued))) {
+			if (message->msg != CURLMSG_DONE)
+				continue;
+
+			i = (message->easy_handle == curl[0]) ? 0 : 1;
+			results[i] = acclHttpResult(tag, curl[i], message->data.result, payloads[i], responses[i]);
+			curl_multi_remove_handle(multi, curl[i]);
+			acclPortalRelease(&client->portals, portals[i], payloads[i]->failure, payloads[i]->answered ? launched[i] : 0);
+			portals[i] = -1;
+			active--;
+
+			if (ACCL_SUCCESS == results[i] && winner < 0)
+				winner = i;
+		}
+
+		if (winner >= 0)
+			break;
+
+		elapsed = acclNow() - started;
+
+		// the first copy is late: send the second one
+		if (hedge && NULL == curl[1] && active > 0 && elapsed >= delay &&
+				(0 == payload->timeout || elapsed / 1000 < payload->timeout)) {
+
+			// preferably on another node
+			portals[1] = acclPortalPick(&client->portals, (portals[0] >= 0) ? 1u << portals[0] : 0);
+			if (portals[1] < 0)
+				portals[1] = acclPortalPick(&client->portals, 0);
+
+			// no second copy when its URI does not fit
+			hedge = (ACCL_SUCCESS == acclHttpUri(client, aspire_portal_uri, sizeof(aspire_portal_uri), portals[1],
+				"exchange", payload->technique_id));
+
+			curl[1] = hedge ? acclHttpAcquire(&client->http_pool) : NULL;
+
+			if (NULL == curl[1]) {
+				portals[1] = -1;
+			} else {
+				if (payload->timeout > 0)
+					hedge_payload.timeout = payload->timeout - (unsigned int)(elapsed / 1000);
+
+#ifndef NDEBUG
+				acclLOG(tag, "no response after %llu us, hedging", ACCL_LOG_LEVEL_INFO, elapsed);
+#endif
+				acclHttpSetup(curl[1], &client->http_pool, &client->timeouts, &client->compression,
+					aspire_portal_uri, &hedge_payload, &hedge_response);
+				curl_multi_add_handle(multi, curl[1]);
+				acclPortalAcquire(&client->portals, portals[1]);
+				launched[1] = acclNow();
+				active++;
+
+				acclStatsRetry(client->stats, payload->technique_id, 1);
+			}
+		}
+
+		if (active > 0)
+			curl_multi_poll(multi, NULL, 0, (NULL == curl[1] && delay > elapsed) ?
+				(int)MIN((delay - elapsed) / 1000 + 1, (unsigned long long)ACCL_ASYNC_POLL_TIMEOUT) :
+				ACCL_ASYNC_POLL_TIMEOUT, NULL);
+	}
+
+	if (1 == winner) {
+		// the caller sees the hedged response as if it were the first one
+		if (!response->external_buffer) {
+			free(response->output_buffer);
+			response->output_buffer = NULL;
+			response->output_buffer_capacity = 0;
+		}
+
+		response->output_buffer_size = 0;
+		response->error = ACCL_SUCCESS;
+
+		results[1] = acclResponseDeliver(response, hedge_response.output_buffer, hedge_response.output_buffer_size);
+	} else {
+		free(hedge_response.output_buffer);
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (NULL == curl[i])
+			continue;
+
+		// abandoned transfer, if any
+		curl_multi_remove_handle(multi, curl[i]);
+
+		if (portals[i] >= 0)
+			acclPortalRelease(&client->portals, portals[i], ACCL_FAILURE_FINAL, 0);
+
+		acclCompressionSample(&client->compression, curl[i]);
+		acclHttpRelease(&client->http_pool, curl[i]);
+		acclPayloadRelease(payloads[i]);
+	}
+
+	curl_multi_cleanup(multi);
+
+	return (winner >= 0) ? results[winner] : results[0];
+}
+
+/*
+	acclHttpPerform under the retry policy of the technique; the payload
+	is rewound and the response emptied before every new attempt
+*/
+static int acclHttpRetry(
+	accl_client* client,
+	const char* tag,
+	const accl_technique* technique,
+	accl_payload_transfer* payload,
+	accl_response* response) {
+
+	accl_retry_policy policy;
+	accl_payload_transfer initial = *payload;
+	unsigned long long started = acclNow();
+	unsigned long long elapsed;
+	unsigned int attempt;
+	unsigned int delay;
+	struct timespec pause;
+	int hedge;
+	int returnValue;
+
+	if (!acclRetryLookup(&client->retry, client->stats, technique, &policy))
+		return acclHttpPerform(client, tag, payload, response);
+
+	// only whole responses of idempotent exchanges can be raced
+	hedge = (policy.flags & ACCL_RETRY_HEDGE) && (policy.flags & ACCL_RETRY_IDEMPOTENT) &&
+		policy.hedge_delay > 0 && NULL != response && NULL == response->stream_callback;
+
+	for (attempt = 1; ; attempt++) {
+		if (hedge)
+			returnValue = acclHttpHedge(client, tag, payload, response, policy.hedge_delay);
+		else
+			returnValue = acclHttpPerform(client, tag, payload, response);
+
+		if (ACCL_SUCCESS == returnValue || attempt >= policy.attempts)
+			break;
+
+		if (payload->failure != ACCL_FAILURE_UNSENT &&
+				!(payload->failure == ACCL_FAILURE_TRANSIENT && (policy.flags & ACCL_RETRY_IDEMPOTENT)))
+			break;
+
+		// streamed chunks cannot be taken back
+		if (NULL != response && NULL != response->stream_callback && response->output_buffer_size > 0)
+			break;
+
+		delay = acclRetryBackoff(&policy, attempt);
+		elapsed = (acclNow() - started) / 1000;
+
+		// retries never outlive the call deadline
+		if (initial.timeout > 0 && elapsed + delay >= initial.timeout)
+			break;
+
+#ifndef NDEBUG
+		acclLOG(tag, "attempt %d failed (%d), retrying in %d ms",
+			ACCL_LOG_LEVEL_WARNING, attempt, returnValue, delay);
+#endif
+
+		pause.tv_sec = delay / 1000;
+		pause.tv_nsec = (long)(delay % 1000) * 1000000L;
+		while (-1 == nanosleep(&pause, &pause) && EINTR == errno)
+			;
+
+		acclStatsRetry(client->stats, payload->technique_id, 0);
+
+		*payload = initial;
+
+		if (initial.timeout > 0) {
+			elapsed = (acclNow() - started) / 1000;
+
+			if (elapsed >= initial.timeout)
+				break;
+
+			payload->timeout = initial.timeout - (unsigned int)elapsed;
+		}
+
+		acclResponseRewind(response);
+	}
+
+	return returnValue;
+}
+
+/*
+	Request whose payload is fully available in memory
+*/
+static int acclHttpRequest(
+	accl_client* client,
+	const char* tag,
+	const int T_ID,
+	const accl_iovec* segments,
+	const unsigned int segmentCount,
+	const int payloadBufferSize,
+	const unsigned int timeout,
+	accl_response* response) {
+
+  	accl_payload_transfer payload;
+  	accl_technique technique;
+  	int returnValue;
+  	unsigned int ttl = 0;
+  	char* cached;
+  	unsigned int cached_size;
+  	unsigned long long started = acclNow();
+
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	// PARAMETERS SANITY CHECK
+	returnValue = acclCheckRequest(tag, T_ID, payloadBufferSize, &technique);
+
+	if (returnValue != ACCL_SUCCESS)
+		return returnValue;
+
+	// cache hits skip the network entirely
+	if (NULL != response)
+		ttl = acclCacheTtl(&client->cache, T_ID, technique.cache_ttl);
+
+	if (ttl > 0 && acclCacheLookup(&client->cache, client->application_id, T_ID,
+			segments, segmentCount, payloadBufferSize, &cached, &cached_size)) {
+#ifndef NDEBUG
+		acclLOG(tag, "response served from cache (%d bytes)", ACCL_LOG_LEVEL_INFO, cached_size);
+#endif
+		returnValue = acclResponseDeliver(response, cached, cached_size);
+	} else {
+		acclPayloadInit(&payload, client->application_id, T_ID, segments, segmentCount, payloadBufferSize);
+		payload.timeout = (timeout > 0) ? timeout : technique.timeout;
+		payload.compression = technique.compression;
+
+		returnValue = acclHttpRetry(client, tag, &technique, &payload, response);
+
+		// streamed responses are never held in full
+		if (ttl > 0 && returnValue == ACCL_SUCCESS && NULL == response->stream_callback)
+			acclCacheStore(&client->cache, client->application_id, T_ID, ttl,
+				segments, segmentCount, payloadBufferSize,
+				response->output_buffer, response->output_buffer_size);
+	}
+
+	acclStatsRecord(client->stats, T_ID, returnValue, started, (unsigned long long)payloadBufferSize,
+		(NULL != response) ? response->output_buffer_size : 0);
+
+	return returnValue;
+}
+
+/*
+	Request whose payload is pulled from a producer callback
+*/
+static int acclHttpChunkedRequest(
+	accl_client* client,
+	const char* tag,
+	const int T_ID,
+	accl_producer_callback producer,
+	void* user_data,
+	accl_response* response) {
+
+  	accl_payload_transfer payload;
+  	accl_technique technique;
+  	int returnValue;
+  	unsigned long long started = acclNow();
+
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	// PARAMETERS SANITY CHECK
+	if (NULL == producer) {
+#ifndef NDEBUG
+		acclLOG(tag, "payload producer not valid", ACCL_LOG_LEVEL_ERROR);
+#endif
+		return ACCL_INPUT_BUFFER_ERROR;
+	}
+
+	returnValue = acclCheckTechnique(tag, T_ID, &technique);
+
+	if (returnValue != ACCL_SUCCESS)
+		return returnValue;
+
+	acclPayloadInit(&payload, client->application_id, T_ID, NULL, 0, 0);
+	payload.timeout = technique.timeout;
+	payload.producer = producer;
+	payload.producer_user_data = user_data;
+
+	returnValue = acclHttpPerform(client, tag, &payload, response);
+
+	acclStatsRecord(client->stats, T_ID, returnValue, started, (unsigned long long)payload.transmit_offset,
+		(NULL != response) ? response->output_buffer_size : 0);
+
+	return returnValue;
+}
+
+/*
+	ACCL Simple Request Protocol Implementation
+	see D1.04 sections 2.2 and 2.4.1 for documentation and API specification
+	see also accl.h for a brief description and parameters explanation
+*/
+int acclClientExchangeDeadline (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int timeout,
+	unsigned* returnBufferSize,
+	char** pReturnBuffer) {
+
+	accl_iovec segment = { pPayloadBuffer, (unsigned int)payloadBufferSize };
+  	accl_response response;
+  	int returnValue;
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "Exchange API invocation.", ACCL_LOG_LEVEL_INFO);
+#endif
+
+	// response buffer is allocated while receiving
+	acclResponseInit(&response, NULL, 0);
+
+	returnValue = acclHttpRequest(client, "acclExchange", T_ID, &segment, 1, payloadBufferSize, timeout, &response);
+
+	if (returnValue != ACCL_SUCCESS) {
+		free(response.output_buffer);
+
+		return returnValue;
+	}
+
+	// return output buffer
+	*pReturnBuffer = response.output_buffer;
+
+	// return output buffer actual size
+	*returnBufferSize = response.output_buffer_size;
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "%d bytes copied into internal buffer.",
+		ACCL_LOG_LEVEL_INFO, response.output_buffer_size);
+#endif
+
+	return ACCL_SUCCESS;
+}
+
+int acclExchangeDeadline (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int timeout,
+	unsigned* returnBufferSize,
+	char** pReturnBuffer) {
+
+	return acclClientExchangeDeadline(acclDefaultClient(), T_ID, payloadBufferSize, pPayloadBuffer,
+		timeout, returnBufferSize, pReturnBuffer);
+}
+
+int acclClientExchange (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	unsigned* returnBufferSize,
+	char** pReturnBuffer) {
+
+	return acclClientExchangeDeadline(client, T_ID, payloadBufferSize, pPayloadBuffer,
+		0, returnBufferSize, pReturnBuffer);
+}
+
+int acclExchange (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	unsigned* returnBufferSize,
+	char** pReturnBuffer) {
+
+	return acclClientExchange(acclDefaultClient(), T_ID, payloadBufferSize, pPayloadBuffer,
+		returnBufferSize, pReturnBuffer);
+}
+
+int acclClientExchangeInto (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int returnBufferCapacity,
+	char* pReturnBuffer,
+	unsigned int* returnBufferSize) {
+
+	accl_iovec segment = { pPayloadBuffer, (unsigned int)payloadBufferSize };
+  	accl_response response;
+  	int returnValue;
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "ExchangeInto API invocation.", ACCL_LOG_LEVEL_INFO);
+#endif
+
+	if (NULL == pReturnBuffer || NULL == returnBufferSize || 0 == returnBufferCapacity) {
+#ifndef NDEBUG
+		acclLOG("acclExchangeInto", "return buffer not valid", ACCL_LOG_LEVEL_ERROR);
+#endif
+		return ACCL_INPUT_BUFFER_ERROR;
+	}
+
+	// data is received straight into the caller buffer
+	acclResponseInit(&response, pReturnBuffer, returnBufferCapacity);
+
+	returnValue = acclHttpRequest(client, "acclExchangeInto", T_ID, &segment, 1, payloadBufferSize, 0, &response);
+
+	*returnBufferSize = response.output_buffer_size;
+
+	return returnValue;
+}
+
+int acclExchangeInto (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int returnBufferCapacity,
+	char* pReturnBuffer,
+	unsigned int* returnBufferSize) {
+
+	return acclClientExchangeInto(acclDefaultClient(), T_ID, payloadBufferSize, pPayloadBuffer,
+		returnBufferCapacity, pReturnBuffer, returnBufferSize);
+}
+
+int acclClientExchangeV (
+	accl_client* client,
+	const int T_ID,
+	const accl_iovec* segments,
+	const unsigned int segmentCount,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer) {
+
+  	accl_response response;
+  	int returnValue;
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "ExchangeV API invocation (%d segments).", ACCL_LOG_LEVEL_INFO, segmentCount);
+#endif
+
+	// response buffer is allocated while receiving
+	acclResponseInit(&response, NULL, 0);
+
+	returnValue = acclHttpRequest(client, "acclExchangeV", T_ID, segments, segmentCount,
+		acclSegmentsSize(segments, segmentCount), 0, &response);
+
+	if (returnValue != ACCL_SUCCESS) {
+		free(response.output_buffer);
+
+		return returnValue;
+	}
+
+	*pReturnBuffer = response.output_buffer;
+	*returnBufferSize = response.output_buffer_size;
+
+	return ACCL_SUCCESS;
+}
+
+int acclExchangeV (
+	const int T_ID,
+	const accl_iovec* segments,
+	const unsigned int segmentCount,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer) {
+
+	return acclClientExchangeV(acclDefaultClient(), T_ID, segments, segmentCount,
+		returnBufferSize, pReturnBuffer);
+}
+
+int acclClientExchangeStream (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	accl_stream_callback callback,
+	void* user_data) {
+
+	accl_iovec segment = { pPayloadBuffer, (unsigned int)payloadBufferSize };
+  	accl_response response;
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "ExchangeStream API invocation.", ACCL_LOG_LEVEL_INFO);
+#endif
+
+	if (NULL == callback) {
+#ifndef NDEBUG
+		acclLOG("acclExchangeStream", "stream callback not valid", ACCL_LOG_LEVEL_ERROR);
+#endif
+		return ACCL_INPUT_BUFFER_ERROR;
+	}
+
+	// chunks are handed to the callback as they arrive, nothing is buffered
+	acclResponseInit(&response, NULL, 0);
+	response.stream_callback = callback;
+	response.stream_user_data = user_data;
+
+	return acclHttpRequest(client, "acclExchangeStream", T_ID, &segment, 1, payloadBufferSize, 0, &response);
+}
+
+int acclExchangeStream (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	accl_stream_callback callback,
+	void* user_data) {
+
+	return acclClientExchangeStream(acclDefaultClient(), T_ID, payloadBufferSize, pPayloadBuffer,
+		callback, user_data);
+}
+
+int acclClientExchangeChunked (
+	accl_client* client,
+	const int T_ID,
+	accl_producer_callback producer,
+	void* user_data,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer) {
+
+  	accl_response response;
+  	int returnValue;
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "ExchangeChunked API invocation.", ACCL_LOG_LEVEL_INFO);
+#endif
+
+	// response buffer is allocated while receiving
+	acclResponseInit(&response, NULL, 0);
+
+	returnValue = acclHttpChunkedRequest(client, "acclExchangeChunked", T_ID, producer, user_data, &response);
+
+	if (returnValue != ACCL_SUCCESS) {
+		free(response.output_buffer);
+
+		return returnValue;
+	}
+
+	*pReturnBuffer = response.output_buffer;
+	*returnBufferSize = response.output_buffer_size;
+
+	return ACCL_SUCCESS;
+}
+
+int acclExchangeChunked (
+	const int T_ID,
+	accl_producer_callback producer,
+	void* user_data,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer) {
+
+	return acclClientExchangeChunked(acclDefaultClient(), T_ID, producer, user_data,
+		returnBufferSize, pReturnBuffer);
+}
+
+/*
+	ACCL Simple Request Protocol Implementation
+	see D1.04 sections 2.2 and 2.4.1 for documentation and API specification
+	see also accl.h for a brief description and parameters explanation
+*/
+int acclClientSendDeadline (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int timeout) {
+
+	accl_iovec segment = { pPayloadBuffer, (unsigned int)payloadBufferSize };
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "Send API invocation.", ACCL_LOG_LEVEL_INFO);
+#endif
+
+	return acclHttpRequest(client, "acclSend", T_ID, &segment, 1, payloadBufferSize, timeout, NULL);
+}
+
+int acclSendDeadline (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int timeout) {
+
+	return acclClientSendDeadline(acclDefaultClient(), T_ID, payloadBufferSize, pPayloadBuffer, timeout);
+}
+
+int acclClientSend (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer) {
+
+	return acclClientSendDeadline(client, T_ID, payloadBufferSize, pPayloadBuffer, 0);
+}
+
+int acclSend (
+        const int T_ID,
+        const int payloadBufferSize,
+        const char* pPayloadBuffer){
+
+	return acclClientSend(acclDefaultClient(), T_ID, payloadBufferSize, pPayloadBuffer);
+}
+
+int acclClientSendV (
+	accl_client* client,
+	const int T_ID,
+	const accl_iovec* segments,
+	const unsigned int segmentCount) {
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "SendV API invocation (%d segments).", ACCL_LOG_LEVEL_INFO, segmentCount);
+#endif
+
+	return acclHttpRequest(client, "acclSendV", T_ID, segments, segmentCount,
+		acclSegmentsSize(segments, segmentCount), 0, NULL);
+}
+
+int acclSendV (
+	const int T_ID,
+	const accl_iovec* segments,
+	const unsigned int segmentCount) {
+
+	return acclClientSendV(acclDefaultClient(), T_ID, segments, segmentCount);
+}
+
+int acclClientSendChunked (
+	accl_client* client,
+	const int T_ID,
+	accl_producer_callback producer,
+	void* user_data) {
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "SendChunked API invocation.", ACCL_LOG_LEVEL_INFO);
+#endif
+
+	return acclHttpChunkedRequest(client, "acclSendChunked", T_ID, producer, user_data, NULL);
+}
+
+int acclSendChunked (
+	const int T_ID,
+	accl_producer_callback producer,
+	void* user_data) {
+
+	return acclClientSendChunked(acclDefaultClient(), T_ID, producer, user_data);
+}
+
+/*
+	Hands the outcome of a finished transfer to the user callback
+*/
+static void acclAsyncComplete(accl_async_request* request, int returnValue) {
+	accl_client* client = request->client;
+
+	if (request->portal >= 0)
+		acclPortalRelease(&client->portals, request->portal, request->payload.failure,
+			request->payload.answered ? request->sent : 0);
+
+	if (ACCL_PRIORITY_BACKGROUND == request->priority)
+		client->async_engine.background--;
+
+	acclStatsRecord(client->stats, request->payload.technique_id, returnValue, request->started,
+		request->payload.payload_size, request->response.output_buffer_size);
+
+	if (returnValue != ACCL_SUCCESS) {
+		free(request->response.output_buffer);
+
+		request->response.output_buffer = NULL;
+		request->response.output_buffer_size = 0;
+	}
+
+	acclCompressionSample(&client->compression, request->curl);
+
+	acclHttpRelease(&client->http_pool, request->curl);
+
+	acclPayloadRelease(&request->payload);
+
+	if (NULL != request->callback)
+		request->callback(returnValue,
+			request->response.output_buffer_size,
+			request->response.output_buffer,
+			request->user_data);
+	else
+		free(request->response.output_buffer);
+
+	free(request);
+}
+
+/*
+	Points a request to portal node n and sets its transfer up,
+	ACCL_GENERIC_ERROR when the request URI does not fit
+*/
+static int acclAsyncPrepare(accl_async_request* request, const int n) {
+	accl_client* client = request->client;
+
+	request->portal = -1;
+	request->tried |= 1u << n;
+
+	if (ACCL_SUCCESS != acclHttpUri(client, request->aspire_portal_uri, sizeof(request->aspire_portal_uri), n,
+			"exchange", request->payload.technique_id))
+		return ACCL_GENERIC_ERROR;
+
+	request->portal = n;
+
+	acclHttpSetup(request->curl, &client->http_pool, &client->timeouts, &client->compression,
+		request->aspire_portal_uri, &request->payload, &request->response);
+	curl_easy_setopt(request->curl, CURLOPT_PRIVATE, request);
+
+	acclPortalAcquire(&client->portals, n);
+	request->sent = acclNow();
+
+	return ACCL_SUCCESS;
+}
+
+/*
+	Moves a request refused by its portal node to the next one, 0 when
+	there is none left
+*/
+static int acclAsyncFailover(accl_async_request* request) {
+	accl_client* client = request->client;
+	unsigned int timeout = request->payload.timeout;
+	unsigned long long elapsed = (acclNow() - request->sent) / 1000;
+	int compression = request->payload.compression;
+	int n;
+
+	if (request->payload.failure != ACCL_FAILURE_UNSENT)
+		return 0;
+
+	// the next node only gets what is left of the deadline
+	if (timeout > 0) {
+		if (elapsed >= timeout)
+			return 0;
+
+		timeout -= (unsigned int)elapsed;
+	}
+
+	n = acclPortalPick(&client->portals, request->tried);
+
+	if (n < 0)
+		return 0;
+
+#ifndef NDEBUG
+	acclLOG("acclExchangeAsync", "failing over to %s", ACCL_LOG_LEVEL_WARNING, client->portals.nodes[n].endpoint);
+#endif
+
+	acclPortalRelease(&client->portals, request->portal, request->payload.failure,
+		request->payload.answered ? request->sent : 0);
+
+	acclPayloadRelease(&request->payload);
+	acclPayloadInit(&request->payload, client->application_id, request->payload.technique_id,
+		&request->segment, 1, request->segment.length);
+	// keep the technique policy set at submission
+	request->payload.timeout = timeout;
+	request->payload.compression = compression;
+	acclResponseRewind(&request->response);
+
+	curl_easy_reset(request->curl);
+
+	return ACCL_SUCCESS == acclAsyncPrepare(request, n) &&
+		CURLM_OK == curl_multi_add_handle(client->async_engine.multi, request->curl);
+}
+
+/*
+	I/O thread main loop, returns once stopping and idle
+*/
+static void* acclAsyncLoop(void* arg) {
+	accl_async_engine* engine = &((accl_client*)arg)->async_engine;
+	accl_async_request* pending;
+	accl_async_request* request;
+	CURLMsg* msg;
+	accl_async_request** link;
+	CURLMcode mres;
+	CURLcode res;
+	int running, left, stopping, held;
+	int returnValue;
+	int priority;
+
+	for (;;) {
+		// move newly submitted requests into the multi handle, higher
+		// classes first: cURL hands free connections out in that order
+		pthread_mutex_lock(&engine->mutex);
+		pending = NULL;
+		link = &pending;
+
+		for (priority = ACCL_PRIORITY_INTERACTIVE; priority > ACCL_PRIORITY_BACKGROUND; priority--) {
+			if (NULL == engine->head[priority])
+				continue;
+
+			*link = engine->head[priority];
+			link = &engine->tail[priority]->next;
+			engine->head[priority] = engine->tail[priority] = NULL;
+		}
+
+		// background requests never take more than their share of the pool
+		while (NULL != (request = engine->head[ACCL_PRIORITY_BACKGROUND]) &&
+				engine->background < ACCL_ASYNC_BACKGROUND_LIMIT) {
+			engine->head[ACCL_PRIORITY_BACKGROUND] = request->next;
+			if (NULL == request->next)
+				engine->tail[ACCL_PRIORITY_BACKGROUND] = NULL;
+
+			request->next = NULL;
+			*link = request;
+			link = &request->next;
+			engine->background++;
+		}
+
+		held = (NULL != engine->head[ACCL_PRIORITY_BACKGROUND]);
+		stopping = engine->stopping;
+		pthread_mutex_unlock(&engine->mutex);
+
+		while (NULL != pending) {
+			request = pending;
+			pending = pending->next;
+
+			mres = curl_multi_add_handle(engine->multi, request->curl);
+
+			if (mres != CURLM_OK) {
+#ifndef NDEBUG
+				acclLOG("acclAsyncLoop",
+					"curl_multi_add_handle() failed: %s",
+					ACCL_LOG_LEVEL_ERROR,
+					curl_multi_strerror(mres));
+#endif
+				acclAsyncComplete(request, ACCL_GENERIC_ERROR);
+			}
+		}
+
+		curl_multi_perform(engine->multi, &running);
+
+		// completed transfers
+		while (NULL != (msg = curl_multi_info_read(engine->multi, &left))) {
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+
+			res = msg->data.result;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&request);
+			curl_multi_remove_handle(engine->multi, request->curl);
+
+			returnValue = acclHttpResult("acclExchangeAsync", request->curl, res, &request->payload, &request->response);
+
+			if (ACCL_SUCCESS != returnValue && acclAsyncFailover(request)) {
+				// still in flight: the loop must not exit yet
+				running++;
+				continue;
+			}
+
+			acclAsyncComplete(request, returnValue);
+		}
+
+		// shutting down: every accepted request has been completed
+		if (stopping && 0 == running && !held)
+			break;
+
+		// completions made room for held background requests
+		if (held && engine->background < ACCL_ASYNC_BACKGROUND_LIMIT)
+			continue;
+
+		// sleep until socket activity, a timeout or a new submission
+		curl_multi_poll(engine->multi, NULL, 0, ACCL_ASYNC_POLL_TIMEOUT, NULL);
+	}
+
+	return NULL;
+}
+
+/*
+	I/O thread start, on the first asynchronous request of a client;
+	engine->mutex held
+*/
+static void acclAsyncStart(accl_client* client) {
+	accl_async_engine* engine = &client->async_engine;
+
+	engine->started = 1;
+	engine->error = ACCL_SUCCESS;
+	memset(engine->head, 0, sizeof(engine->head));
+	memset(engine->tail, 0, sizeof(engine->tail));
+	engine->background = 0;
+
+	engine->multi = curl_multi_init();
+
+	if (NULL == engine->multi) {
+		engine->error = ACCL_CURL_INITIALIZATION_ERROR;
+		return;
+	}
+
+	// excess requests wait inside cURL for a connection to become idle
+	curl_multi_setopt(engine->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)ACCL_HTTP_POOL_SIZE);
+
+	if (0 != pthread_create(&engine->thread, NULL, acclAsyncLoop, client)) {
+		curl_multi_cleanup(engine->multi);
+		engine->multi = NULL;
+		engine->error = ACCL_GENERIC_ERROR;
+	}
+}
+
+/*
+	Stops accepting requests, waits for the outstanding ones and joins
+	the I/O thread
+*/
+static void acclAsyncShutdown(accl_client* client) {
+	accl_async_engine* engine = &client->async_engine;
+	int running;
+
+	pthread_mutex_lock(&engine->mutex);
+	engine->stopping = 1;
+	running = engine->started && NULL != engine->multi;
+	pthread_mutex_unlock(&engine->mutex);
+
+	if (!running)
+		return;
+
+	curl_multi_wakeup(engine->multi);
+	pthread_join(engine->thread, NULL);
+
+	curl_multi_cleanup(engine->multi);
+	engine->multi = NULL;
+}
+
+/*
+	Queues an exchange on the I/O thread; the payload is either copied or
+	referenced in place (the caller then keeps it alive until completion)
+*/
+static int acclAsyncSubmit (
+	accl_client* client,
+	const char* tag,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	int copy_payload,
+	accl_exchange_callback callback,
+	void* user_data) {
+
+	accl_async_engine* engine;
+	accl_async_request* request;
+	accl_technique technique;
+	CURL* curl;
+	int returnValue;
+
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	engine = &client->async_engine;
+
+	// PARAMETERS SANITY CHECK
+	returnValue = acclCheckRequest(tag, T_ID, payloadBufferSize, &technique);
+
+	if (returnValue != ACCL_SUCCESS)
+		return returnValue;
+
+	// pooled handle (cURL is initialized once per process)
+	curl = acclHttpAcquire(&client->http_pool);
+
+	if (NULL == curl)
+		return ACCL_CURL_INITIALIZATION_ERROR;
+
+	pthread_mutex_lock(&engine->mutex);
+	if (!engine->started)
+		acclAsyncStart(client);
+	returnValue = engine->stopping ? ACCL_GENERIC_ERROR : engine->error;
+	pthread_mutex_unlock(&engine->mutex);
+
+	if (returnValue != ACCL_SUCCESS) {
+		acclHttpRelease(&client->http_pool, curl);
+
+		return returnValue;
+	}
+
+	// a copied payload is stored right after the request
+	request = (accl_async_request*)malloc(sizeof(accl_async_request) + (copy_payload ? payloadBufferSize : 0));
+
+	if (NULL == request) {
+		acclHttpRelease(&client->http_pool, curl);
+
+		return ACCL_GENERIC_ERROR;
+	}
+
+	if (copy_payload) {
+		memcpy(request + 1, pPayloadBuffer, payloadBufferSize);
+		pPayloadBuffer = (const char*)(request + 1);
+	}
+
+	request->client = client;
+	request->curl = curl;
+	request->callback = callback;
+	request->user_data = user_data;
+	request->started = acclNow();
+	request->next = NULL;
+
+	// payload structure initialization
+	request->segment.base = pPayloadBuffer;
+	request->segment.length = payloadBufferSize;
+
+	acclPayloadInit(&request->payload, client->application_id, T_ID, &request->segment, 1, payloadBufferSize);
+	request->payload.timeout = technique.timeout;
+	request->payload.compression = technique.compression;
+
+	// response structure initialization
+	acclResponseInit(&request->response, NULL, 0);
+
+	request->priority = technique.priority;
+	request->tried = 0;
+
+	if (ACCL_SUCCESS != acclAsyncPrepare(request, acclPortalPick(&client->portals, 0))) {
+		acclPayloadRelease(&request->payload);
+		acclHttpRelease(&client->http_pool, curl);
+		free(request);
+
+		return ACCL_GENERIC_ERROR;
+	}
+
+	// enqueue and wake the I/O thread up
+	pthread_mutex_lock(&engine->mutex);
+	if (NULL == engine->tail[request->priority])
+		engine->head[request->priority] = request;
+	else
+		engine->tail[request->priority]->next = request;
+	engine->tail[request->priority] = request;
+	pthread_mutex_unlock(&engine->mutex);
+
+	curl_multi_wakeup(engine->multi);
+
+	return ACCL_SUCCESS;
+}
+
+int acclClientExchangeAsync (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	accl_exchange_callback callback,
+	void* user_data) {
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "ExchangeAsync API invocation.", ACCL_LOG_LEVEL_INFO);
+#endif
+
+	// the caller may reuse its buffer as soon as we return
+	return acclAsyncSubmit(client, "acclExchangeAsync", T_ID, payloadBufferSize, pPayloadBuffer,
+		1, callback, user_data);
+}
+
+int acclExchangeAsync (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	accl_exchange_callback callback,
+	void* user_data) {
+
+	return acclClientExchangeAsync(acclDefaultClient(), T_ID, payloadBufferSize, pPayloadBuffer,
+		callback, user_data);
+}
+
+/*
+	ACCL batch exchange
+	entries are multiplexed on the I/O thread, the caller waits for all of them
+*/
+typedef struct accl_batch {
+	pthread_mutex_t mutex;
+	pthread_cond_t done;
+	unsigned int remaining;					/* entries still in flight */
+} accl_batch;
+
+typedef struct accl_batch_slot {
+	accl_batch* batch;
+	accl_batch_entry* entry;
+} accl_batch_slot;
+
+static void acclBatchCallback(int error, unsigned int returnBufferSize, char* pReturnBuffer, void* user_data) {
+	accl_batch_slot* slot = (accl_batch_slot*)user_data;
+
+	slot->entry->error = error;
+	slot->entry->return_buffer_size = returnBufferSize;
+	slot->entry->return_buffer = pReturnBuffer;
+
+	pthread_mutex_lock(&slot->batch->mutex);
+	if (0 == --slot->batch->remaining)
+		pthread_cond_signal(&slot->batch->done);
+	pthread_mutex_unlock(&slot->batch->mutex);
+}
+
+int acclClientExchangeBatch (
+	accl_client* client,
+	accl_batch_entry* entries,
+	const unsigned int count) {
+
+	accl_batch batch;
+	accl_batch_slot* slots;
+	unsigned int i;
+	int error;
+	int returnValue = ACCL_SUCCESS;
+
+#ifndef NDEBUG
+	acclLOG("ACCL", "ExchangeBatch API invocation (%d entries).", ACCL_LOG_LEVEL_INFO, count);
+#endif
+
+	if (NULL == entries || 0 == count)
+		return ACCL_INPUT_BUFFER_ERROR;
+
+	slots = (accl_batch_slot*)malloc(sizeof(accl_batch_slot) * count);
+
+	if (NULL == slots)
+		return ACCL_GENERIC_ERROR;
+
+	pthread_mutex_init(&batch.mutex, NULL);
+	pthread_cond_init(&batch.done, NULL);
+	batch.remaining = count;
+
+	for (i = 0; i < count; i++) {
+		slots[i].batch = &batch;
+		slots[i].entry = &entries[i];
+
+		entries[i].return_buffer_size = 0;
+		entries[i].return_buffer = NULL;
+		entries[i].error = ACCL_SUCCESS;
+
+		// payloads are referenced in place, we do not return before completion
+		error = acclAsyncSubmit(client, "acclExchangeBatch",
+			entries[i].technique_id,
+			entries[i].payload_size,
+			entries[i].payload_buffer,
+			0, acclBatchCallback, &slots[i]);
+
+		// rejected entries will never be completed by the I/O thread
+		if (error != ACCL_SUCCESS) {
+			entries[i].error = error;
+
+			pthread_mutex_lock(&batch.mutex);
+			batch.remaining--;
+			pthread_mutex_unlock(&batch.mutex);
+		}
+	}
+
+	pthread_mutex_lock(&batch.mutex);
+	while (batch.remaining > 0)
+		pthread_cond_wait(&batch.done, &batch.mutex);
+	pthread_mutex_unlock(&batch.mutex);
+
+	for (i = 0; i < count; i++) {
+		if (entries[i].error != ACCL_SUCCESS)
+			returnValue = ACCL_BATCH_ERROR;
+	}
+
+	pthread_cond_destroy(&batch.done);
+	pthread_mutex_destroy(&batch.mutex);
+	free(slots);
+
+	return returnValue;
+}
+
+int acclExchangeBatch (
+	accl_batch_entry* entries,
+	const unsigned int count) {
+
+	return acclClientExchangeBatch(acclDefaultClient(), entries, count);
+}
+
+static size_t acclWarmupDiscard(char *ptr, size_t size, size_t nmemb, void *userdata) {
+	return size * nmemb;
+}
+
+/*
+	Opens ACCL_WARMUP_CONNECTIONS keep-alive connections to every portal
+	node at once; any HTTP answer will do, the connections (and the DNS
+	answers) stay in the pool shared cache for the requests to come
+*/
+static int acclWarmupHttp(accl_client* client) {
+	unsigned int connections = MIN(ACCL_WARMUP_CONNECTIONS, ACCL_HTTP_POOL_SIZE);
+	CURL* handles[ACCL_MAX_PORTALS * MIN(ACCL_WARMUP_CONNECTIONS, ACCL_HTTP_POOL_SIZE)];
+	unsigned int count = 0;
+	unsigned int warmed = 0;
+	unsigned int n, c, i;
+	CURLMsg* message;
+	CURLM* multi;
+	long http_response_code;
+	int running, queued;
+
+	multi = curl_multi_init();
+
+	if (NULL == multi)
+		return ACCL_CURL_INITIALIZATION_ERROR;
+
+	for (n = 0; n < client->portals.count; n++) {
+		for (c = 0; c < connections; c++) {
+			CURL* curl = acclHttpAcquire(&client->http_pool);
+
+			if (NULL == curl)
+				break;
+
+			acclHttpConnectionSetup(curl, &client->http_pool, &client->timeouts, 0);
+
+			curl_easy_setopt(curl, CURLOPT_URL, client->portals.nodes[n].endpoint);
+			curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, acclWarmupDiscard);
+			curl_easy_setopt(curl, CURLOPT_PRIVATE, (char*)(uintptr_t)n);
+
+			// one connection each, even where cURL could wait for a reusable one
+			curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 0L);
+
+			curl_multi_add_handle(multi, curl);
+			handles[count++] = curl;
+		}
+	}
+
+	do {
+		curl_multi_perform(multi, &running);
+
+		while (NULL != (message = curl_multi_info_read(multi, &queued))) {
+			char* node;
+
+			if (message->msg != CURLMSG_DONE)
+				continue;
+
+			curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &node);
+			n = (unsigned int)(uintptr_t)node;
+
+			http_response_code = 0;
+			curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &http_response_code);
+
+			// reachable nodes are put back in rotation right away
+			if (CURLE_OK == message->data.result && http_response_code > 0) {
+				__atomic_store_n(&client->portals.nodes[n].down_until, 0, __ATOMIC_RELAXED);
+				warmed++;
+			} else {
+#ifndef NDEBUG
+				acclLOG("acclWarmup", "%s: %s", ACCL_LOG_LEVEL_WARNING,
+					client->portals.nodes[n].endpoint, curl_easy_strerror(message->data.result));
+#endif
+				if (CURLE_COULDNT_RESOLVE_HOST == message->data.result ||
+						CURLE_COULDNT_CONNECT == message->data.result)
+					acclPortalDown(&client->portals, (int)n);
+			}
+		}
+
+		if (running > 0)
+			curl_multi_poll(multi, NULL, 0, ACCL_ASYNC_POLL_TIMEOUT, NULL);
+	} while (running > 0);
+
+	for (i = 0; i < count; i++) {
+		curl_multi_remove_handle(multi, handles[i]);
+		acclHttpRelease(&client->http_pool, handles[i]);
+	}
+
+	curl_multi_cleanup(multi);
+
+#ifndef NDEBUG
+	acclLOG("acclWarmup", "%d of %d connections opened", ACCL_LOG_LEVEL_INFO, warmed, count);
+#endif
+
+	return (warmed > 0) ? ACCL_SUCCESS : ACCL_GENERIC_ERROR;
+}
+
+#ifndef WITHOUT_WEBSOCKETS
+/*
+	Opens the WebSockets channels of the given techniques, unless already
+	waiting to be claimed
+*/
+static int acclWarmupChannels(accl_client* client, const int* techniques, const unsigned int count) {
+	accl_warmup* warmup = &client->warmup;
+	struct libwebsocket_context* context;
+	int returnValue = ACCL_SUCCESS;
+	unsigned int t, i;
+	int slot;
+
+	for (t = 0; t < count; t++) {
+		pthread_mutex_lock(&warmup->mutex);
+
+		for (slot = -1, i = 0; i < ACCL_WARMUP_MAX_CHANNELS; i++) {
+			if (warmup->channels[i].technique_id == techniques[t])
+				break;
+
+			if (slot < 0 && 0 == warmup->channels[i].technique_id)
+				slot = (int)i;
+		}
+
+		// reserved while connecting
+		if (i == ACCL_WARMUP_MAX_CHANNELS && slot >= 0)
+			warmup->channels[slot].technique_id = techniques[t];
+
+		pthread_mutex_unlock(&warmup->mutex);
+
+		if (i < ACCL_WARMUP_MAX_CHANNELS || slot < 0)
+			continue;
+
+		context = acclClientWebSocketInit(client, techniques[t], NULL);
+
+		pthread_mutex_lock(&warmup->mutex);
+		if (NULL != context)
+			warmup->channels[slot].context = context;
+		else
+			warmup->channels[slot].technique_id = 0;
+		pthread_mutex_unlock(&warmup->mutex);
+
+		if (NULL == context)
+			returnValue = ACCL_GENERIC_ERROR;
+	}
+
+	return returnValue;
+}
+
+/*
+	Hands a warmed up channel over to acclWebSocketInit, NULL if none
+*/
+static struct libwebsocket_context* acclWarmupClaim(accl_client* client, const int T_ID) {
+	accl_warmup* warmup = &client->warmup;
+	struct libwebsocket_context* context = NULL;
+	unsigned int i;
+
+	pthread_mutex_lock(&warmup->mutex);
+
+	for (i = 0; i < ACCL_WARMUP_MAX_CHANNELS; i++) {
+		if (warmup->channels[i].technique_id == T_ID && NULL != warmup->channels[i].context) {
+			context = warmup->channels[i].context;
+			warmup->channels[i].technique_id = 0;
+			warmup->channels[i].context = NULL;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&warmup->mutex);
+
+	return context;
+}
+#endif
+
+static int acclWarmupRun(accl_client* client, const int* techniques, const unsigned int count) {
+	int returnValue = acclWarmupHttp(client);
+
+#ifndef WITHOUT_WEBSOCKETS
+	int channels = acclWarmupChannels(client, techniques, count);
+
+	if (ACCL_SUCCESS == returnValue)
+		returnValue = channels;
+#endif
+
+	return returnValue;
+}
+
+static void* acclWarmupLoop(void* arg) {
+	accl_client* client = (accl_client*)arg;
+	int returnValue;
+
+	returnValue = acclWarmupRun(client, client->warmup.techniques, client->warmup.technique_count);
+
+#ifndef NDEBUG
+	acclLOG("acclWarmup", "background warm-up done (%d)", ACCL_LOG_LEVEL_INFO, returnValue);
+#else
+	(void)returnValue;
+#endif
+
+	return NULL;
+}
+
+/*
+	Joins the background warm-up and closes the channels never claimed
+*/
+static void acclWarmupDestroy(accl_client* client) {
+	accl_warmup* warmup = &client->warmup;
+#ifndef WITHOUT_WEBSOCKETS
+	unsigned int i;
+#endif
+
+	if (warmup->running)
+		pthread_join(warmup->thread, NULL);
+
+#ifndef WITHOUT_WEBSOCKETS
+	for (i = 0; i < ACCL_WARMUP_MAX_CHANNELS; i++) {
+		if (NULL != warmup->channels[i].context)
+			acclWebSocketShutdown(warmup->channels[i].context);
+	}
+#endif
+
+	pthread_mutex_destroy(&warmup->mutex);
+}
+
+int acclClientWarmup(accl_client* client, const int* techniqueIds, unsigned int count, const int background) {
+	int registered[ACCL_WARMUP_MAX_CHANNELS];
+	accl_warmup* warmup;
+	int returnValue;
+	unsigned int i;
+
+	if (NULL == client)
+		return ACCL_INVALID_CLIENT;
+
+	warmup = &client->warmup;
+
+	// PARAMETERS SANITY CHECK
+	if (count > ACCL_WARMUP_MAX_CHANNELS || (count > 0 && NULL == techniqueIds))
+		return ACCL_INPUT_BUFFER_ERROR;
+
+	// no list: the channels of the techniques preferring WebSockets
+	if (NULL == techniqueIds) {
+		count = acclRegistryList(ACCL_TRANSPORT_WEBSOCKETS, registered, ACCL_WARMUP_MAX_CHANNELS);
+		techniqueIds = registered;
+	}
+
+	for (i = 0; i < count; i++) {
+		returnValue = acclCheckTechnique("acclWarmup", techniqueIds[i], NULL);
+
+		if (returnValue != ACCL_SUCCESS)
+			return returnValue;
+	}
+
+	if (!background)
+		return acclWarmupRun(client, techniqueIds, count);
+
+	pthread_mutex_lock(&warmup->mutex);
+
+	// one background warm-up at a time
+	if (warmup->running) {
+		pthread_mutex_unlock(&warmup->mutex);
+		pthread_join(warmup->thread, NULL);
+		pthread_mutex_lock(&warmup->mutex);
+		warmup->running = 0;
+	}
+
+	memcpy(warmup->techniques, techniqueIds, count * sizeof(int));
+	warmup->technique_count = count;
+
+	returnValue = ACCL_SUCCESS;
+
+	if (0 == pthread_create(&warmup->thread, NULL, acclWarmupLoop, client))
+		warmup->running = 1;
+	else
+		returnValue = ACCL_GENERIC_ERROR;
+
+	pthread_mutex_unlock(&warmup->mutex);
+
+	return returnValue;
+}
+
+int acclWarmup(const int* techniqueIds, const unsigned int count, const int background) {
+	return acclClientWarmup(acclDefaultClient(), techniqueIds, count, background);
+}
+
+/*
+	Custom data sending callback (invoked by libcurl)
+	walks the payload segments, contiguous payloads never get here
+*/
+size_t read_callback(void *ptr, size_t size, size_t nmemb, void *userp){
+	accl_payload_transfer *data = (accl_payload_transfer *)userp;
+	accl_iovec single;
+	const accl_iovec* segments = data->segments;
+	unsigned int segment_count = data->segment_count;
+	size_t room = size * nmemb;
+	size_t copied = 0;
+	size_t bytes_to_transfer;
+
+#ifndef NDEBUG
+	acclLOG("read_callback",
+		"size %d payload size %d",
+		ACCL_LOG_LEVEL_DEBUG,
+		(int)size * (int)nmemb,
+		data->payload_size);
+#endif
+
+	// callback called for no actual data transfer
+	if (room < 1) {
+#ifndef NDEBUG
+		acclLOG("read_callback", "size * nmemb < 1", ACCL_LOG_LEVEL_DEBUG);
+#endif
+		return 0;
+	}
+
+	// plain contiguous buffer
+	if (NULL == segments) {
+		single.base = data->payload_buffer;
+		single.length = data->payload_size;
+		segments = &single;
+		segment_count = 1;
+	}
+
+	while (room > 0 && data->segment_index < segment_count) {
+		const accl_iovec* segment = &segments[data->segment_index];
+
+		// compute how much data to send is left in the current segment
+		bytes_to_transfer = MIN(segment->length - data->segment_offset, room);
+
+		// copy data from input segment
+		memcpy ((char*)ptr + copied,
+				(const char*)segment->base + data->segment_offset,
+				bytes_to_transfer);
+
+		copied += bytes_to_transfer;
+		room -= bytes_to_transfer;
+		data->segment_offset += bytes_to_transfer;
+
+		// advance to the next segment
+		if (data->segment_offset == segment->length) {
+			data->segment_index++;
+			data->segment_offset = 0;
+		}
+	}
+
+	// advances transmission offset
+	data->transmit_offset += copied;
+
+	return copied;
+}
+
+/*
+	Custom rewind callback (invoked by libcurl when a request is re-sent)
+*/
+static int seek_callback(void *userp, curl_off_t offset, int origin) {
+	accl_payload_transfer *data = (accl_payload_transfer *)userp;
+	unsigned int index = 0;
+
+	if (origin != SEEK_SET || offset < 0 || offset > data->payload_size)
+		return CURL_SEEKFUNC_CANTSEEK;
+
+	data->transmit_offset = (int)offset;
+
+	if (NULL != data->segments) {
+		while (index < data->segment_count && offset >= data->segments[index].length) {
+			offset -= data->segments[index].length;
+			index++;
+		}
+	}
+
+	data->segment_index = index;
+	data->segment_offset = (unsigned int)offset;
+
+	return CURL_SEEKFUNC_OK;
+}
+
+/*
+	Chunked upload sending callback (invoked by libcurl)
+	the producer writes straight into the cURL upload buffer
+*/
+static size_t producer_read(void *ptr, size_t size, size_t nmemb, void *userp) {
+	accl_payload_transfer *data = (accl_payload_transfer *)userp;
+	size_t room = MIN(size * nmemb, (size_t)INT_MAX);
+	int produced;
+
+	produced = data->producer((char*)ptr, (unsigned int)room, data->producer_user_data);
+
+	if (produced < 0 || (size_t)produced > room) {
+#ifndef NDEBUG
+		acclLOG("producer_read", "payload producer failed (%d)",
+			ACCL_LOG_LEVEL_ERROR,
+			produced);
+#endif
+		data->error = ACCL_PRODUCER_ABORTED;
+
+		return CURL_READFUNC_ABORT;
+	}
+
+	// advances transmission offset
+	data->transmit_offset += produced;
+
+	// 0 terminates the chunked upload
+	return (size_t)produced;
+}
+
+/*
+	Streaming variant of the receiving callback: every chunk is passed on to
+	the user callback, error pages are not
+*/
+static size_t stream_write(accl_response* response, char *ptr, size_t length) {
+	long http_response_code = 0;
+
+	if (0 == response->output_buffer_size) {
+		curl_easy_getinfo(response->curl_handle, CURLINFO_RESPONSE_CODE, &http_response_code);
+
+		// acclHttpResult reports the server error once the transfer is over
+		if (http_response_code != 200)
+			return length;
+	}
+
+	// output_buffer_size only counts delivered bytes here
+	response->output_buffer_size += (unsigned int)length;
+
+	if (0 != response->stream_callback(ptr, (unsigned int)length, response->stream_user_data)) {
+#ifndef NDEBUG
+		acclLOG("write_callback", "stream aborted by callback after %d bytes",
+			ACCL_LOG_LEVEL_INFO,
+			response->output_buffer_size);
+#endif
+		response->error = ACCL_STREAM_ABORTED;
+
+		// cause curl abort current transfer
+		return -1;
+	}
+
+	return length;
+}
+
+/*
+	Custom data receiving callback (invoked by libcurl)
+*/
+size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userdata) {
+	accl_response* response = (accl_response*)userdata;
+	size_t required = response->output_buffer_size + size * nmemb;
+	size_t capacity;
+	curl_off_t content_length = -1;
+	char* buffer;
+
+#ifndef NDEBUG
+	acclLOG("write_callback",
+		"size=%d offset=%d",
+		ACCL_LOG_LEVEL_DEBUG,
+		(int)(size * nmemb),
+		response->output_buffer_size);
+#endif
+
+	// streaming mode: no buffering and no size limit
+	if (NULL != response->stream_callback)
+		return stream_write(response, ptr, size * nmemb);
+
+	// maximum buffer size check
+	if (required > ACCL_MAX_BUFFER_SIZE ||
+			(response->external_buffer && required > response->output_buffer_capacity)) {
+
+#ifndef NDEBUG
+		acclLOG("write_callback", "return buffer size exceeded (%d requested)",
+			ACCL_LOG_LEVEL_ERROR,
+			(int)required);
+#endif
+		response->error = ACCL_OUTPUT_BUFFER_MAX_SIZE_EXCEEDED;
+
+		// cause curl abort current transfer
+		return -1;
+	}
+
+	// allocates necessary memory
+	if (required > response->output_buffer_capacity) {
+		capacity = response->output_buffer_capacity;
+
+		if (0 == capacity) {
+			// presize from the announced length, when the server sent one
+			if (NULL != response->curl_handle)
+				curl_easy_getinfo(response->curl_handle,
+					CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+
+			if (content_length > 0 && content_length <= ACCL_MAX_BUFFER_SIZE)
+				capacity = (size_t)content_length;
+			else
+				capacity = ACCL_RESPONSE_INITIAL_SIZE;
+		}
+
+		// geometric growth keeps the number of reallocations logarithmic
+		while (capacity < required)
+			capacity *= 2;
+
+		capacity = MIN(capacity, ACCL_MAX_BUFFER_SIZE);
+
+		buffer = (char*)realloc((void*)response->output_buffer, capacity);
+
+		if (0 == buffer) {
+			response->error = ACCL_OUTPUT_BUFFER_ALLOCATION_ERROR;
+
+			// cause curl abort current transfer
+			return -1;
+		}
+
+		response->output_buffer = buffer;
+		response->output_buffer_capacity = capacity;
+	}
+
+	// copy data to return structure
+	memcpy (response->output_buffer + response->output_buffer_size,
+				ptr,
+				size * nmemb);
+
+	// advance receiving offset
+	response->output_buffer_size += (int)(nmemb * size);
+
+	return (nmemb * size);
+}
+
+#ifndef NDEBUG
+
+/*
+	ACCL logging backend
+	callers format their record straight into a slot of a lock-free ring
+	(bounded multi-producer queue, one sequence number per slot); a
+	background thread drains the ring in batches through one long-lived
+	file descriptor. Records are dropped and counted when the ring is full
+*/
+typedef struct accl_log_slot {
+	unsigned long sequence;					/* slot state, see acclLOG */
+	unsigned int length;					/* record length */
+	char record[ACCL_MSG_STRING_LENGTH];
+} accl_log_slot;
+
+typedef struct accl_log_ring {
+	accl_log_slot* slots;					/* ACCL_LOG_RING_SIZE slots */
+	unsigned long enqueue_position;			/* next slot to be claimed */
+	unsigned long dequeue_position;			/* next slot to be written out */
+	unsigned long dropped;					/* records lost to overflow */
+	sem_t pending;							/* wakes the writer thread up */
+	int fd;									/* accl.log */
+	pthread_t thread;
+	int ready;								/* ring usable */
+} accl_log_ring;
+
+static accl_log_ring log_ring;
+static pthread_once_t log_ring_once = PTHREAD_ONCE_INIT;
+
+/*
+	Writer thread: moves published records to the log file in batches
+*/
+static void acclLogDrain(char* batch) {
+	accl_log_slot* slot;
+	unsigned long position = __atomic_load_n(&log_ring.dequeue_position, __ATOMIC_RELAXED);
+	unsigned long dropped;
+	size_t length = 0;
+	ssize_t written;
+
+	for (;;) {
+		slot = &log_ring.slots[position & (ACCL_LOG_RING_SIZE - 1)];
+
+		// stop at the first slot not published yet
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != position + 1)
+			break;
+
+		if (length + slot->length > ACCL_LOG_BATCH_SIZE) {
+			written = write(log_ring.fd, batch, length);
+			(void)written;
+			length = 0;
+		}
+
+		memcpy(batch + length, slot->record, slot->length);
+		length += slot->length;
+
+		// hand the slot back to producers for the next lap
+		__atomic_store_n(&slot->sequence, position + ACCL_LOG_RING_SIZE, __ATOMIC_RELEASE);
+		position++;
+	}
+
+	__atomic_store_n(&log_ring.dequeue_position, position, __ATOMIC_RELEASE);
+
+	dropped = __atomic_exchange_n(&log_ring.dropped, 0, __ATOMIC_RELAXED);
+
+	if (dropped > 0 && length + ACCL_MSG_STRING_LENGTH <= ACCL_LOG_BATCH_SIZE)
+		length += snprintf(batch + length, ACCL_MSG_STRING_LENGTH,
+			"[acclLOG] %lu records dropped (log ring full)\n", dropped);
+
+	if (length > 0) {
+		written = write(log_ring.fd, batch, length);
+		(void)written;
+	}
+}
+
+static void* acclLogWriter(void* arg) {
+	char* batch = (char*)arg;
+
+	for (;;) {
+		while (0 != sem_wait(&log_ring.pending))
+			;
+
+		acclLogDrain(batch);
+	}
+
+	return NULL;
+}
+
+/*
+	Flushes pending records at process exit (bounded wait)
+*/
+static void acclLogFlush(void) {
+	unsigned long target = __atomic_load_n(&log_ring.enqueue_position, __ATOMIC_ACQUIRE);
+	int tries;
+
+	sem_post(&log_ring.pending);
+
+	for (tries = 0; tries < 100; tries++) {
+		if ((long)(__atomic_load_n(&log_ring.dequeue_position, __ATOMIC_ACQUIRE) - target) >= 0)
+			break;
+
+		usleep(1000);
+	}
+}
+
+static void acclLogInit(void) {
+	char* batch;
+	unsigned long i;
+
+	log_ring.fd = open(ACCL_FILE_PATH "/" ACCL_LOG_FILE, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+
+	if (log_ring.fd < 0) {
+		fprintf(stderr, "ERROR: Unable to log to file accl.log\n");
+		return;
+	}
+
+	log_ring.slots = (accl_log_slot*)malloc(sizeof(accl_log_slot) * ACCL_LOG_RING_SIZE);
+	batch = (char*)malloc(ACCL_LOG_BATCH_SIZE);
+
+	if (NULL == log_ring.slots || NULL == batch) {
+		free(log_ring.slots);
+		free(batch);
+		close(log_ring.fd);
+		return;
+	}
+
+	// slot i is free for the producer claiming position i
+	for (i = 0; i < ACCL_LOG_RING_SIZE; i++)
+		log_ring.slots[i].sequence = i;
+
+	log_ring.enqueue_position = 0;
+	log_ring.dequeue_position = 0;
+	log_ring.dropped = 0;
+
+	sem_init(&log_ring.pending, 0, 0);
+
+	if (0 != pthread_create(&log_ring.thread, NULL, acclLogWriter, batch)) {
+		free(log_ring.slots);
+		free(batch);
+		close(log_ring.fd);
+		return;
+	}
+
+	pthread_detach(log_ring.thread);
+	atexit(acclLogFlush);
+
+	log_ring.ready = 1;
+}
+
+/*
+	Logging utility
+*/
+void acclLOG(const char* tag, const char* fmt, int lvl, ...) {
+	accl_log_slot* slot;
+	unsigned long position;
+	unsigned long sequence;
+	long difference;
+	struct tm local_time;
 	time_t now;
-	
-	va_list ap;                                /* special type for variable */
-	char format[ACCL_MSG_STRING_LENGTH];       /* argument lists            */
-	int count = 0;
-	int i, j;                                  /* Need all these to store   */
-	char c;                                    /* values below in switch    */
-	double d;
-	unsigned u;
-	char *s;
-	void *v;
-	
+	va_list ap;
+	int length;
+
 	if (lvl < ACCL_LOG_LEVEL)
 		return;
-	
-	fp = fopen (ACCL_FILE_PATH "/" ACCL_LOG_FILE, "a");
-	
-	if (NULL == fp) {
-		fprintf(stderr, "ERROR: Unable to log to file accl.log\n");
-		return;	
+
+	pthread_once(&log_ring_once, acclLogInit);
+
+	if (!log_ring.ready)
+		return;
+
+	// claim a slot
+	position = __atomic_load_n(&log_ring.enqueue_position, __ATOMIC_RELAXED);
+
+	for (;;) {
+		slot = &log_ring.slots[position & (ACCL_LOG_RING_SIZE - 1)];
+		sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		difference = (long)(sequence - position);
+
+		if (0 == difference) {
+			if (__atomic_compare_exchange_n(&log_ring.enqueue_position, &position, position + 1,
+					1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (difference < 0) {
+			// ring full: the writer is a whole lap behind
+			__atomic_fetch_add(&log_ring.dropped, 1, __ATOMIC_RELAXED);
+			return;
+		} else {
+			position = __atomic_load_n(&log_ring.enqueue_position, __ATOMIC_RELAXED);
+		}
+	}
+
+	// format the record in place
+	time(&now);
+	localtime_r(&now, &local_time);
+
+	length = strftime(slot->record, ACCL_MSG_STRING_LENGTH, "%a %b %d %H:%M:%S %Y", &local_time);
+	length += snprintf(slot->record + length, ACCL_MSG_STRING_LENGTH - length, " [%s] ", tag);
+
+	if (length < ACCL_MSG_STRING_LENGTH - 1) {
+		va_start(ap, lvl);
+		length += vsnprintf(slot->record + length, ACCL_MSG_STRING_LENGTH - length, fmt, ap);
+		va_end(ap);
+	}
+
+	// truncated records still end with a newline
+	if (length > ACCL_MSG_STRING_LENGTH - 2)
+		length = ACCL_MSG_STRING_LENGTH - 2;
+
+	slot->record[length++] = '\n';
+	slot->length = length;
+
+	// publish
+	__atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+
+	sem_post(&log_ring.pending);
+}
+#endif
+
+/* 
+	ASPIRE CLIENT COMMUNICATION LOGIC - WEBSOCKET PROTOCOL
+	
+*/
+
+#ifndef WITHOUT_WEBSOCKETS
+
+/* list of supported protocols and callbacks, copied in every client
+   context; channels bring their own per connection data */
+static struct libwebsocket_protocols protocols[] = {
+	{
+		"accl-communication-protocol",
+		callback_accl_communication,
+		0,
+	},
+	{  
+		/* end of list */
+		NULL,
+		NULL,
+		0
+	}
+};
+
+/*
+	Exchange waiting for its response on a WebSockets channel; it lives on
+	the stack of the waiting thread, linked in the channel pending table
+*/
+#define ACCL_WS_PENDING		-1
+
+struct accl_ws_exchange {
+	unsigned int id;						/* request id, echoed by the portal */
+	char* buffer;							/* caller response buffer */
+	unsigned int capacity;
+	unsigned int size;						/* response size */
+	int status;								/* ACCL_WS_PENDING, then the return value */
+	pthread_cond_t done;					/* status set */
+	const char* payload;					/* caller request, sent again after a drop */
+	unsigned int payload_size;
+	int written;							/* the request left the queue on the current connection */
+	struct accl_ws_exchange* next;			/* bucket link */
+};
+
+/*
+	Per-message deflate of a channel connection, reset when it drops;
+	service thread only
+*/
+#define ACCL_WS_DEFLATE_OFF			0		/* declined, or not offered yet */
+#define ACCL_WS_DEFLATE_OFFERING	1		/* offer to write first */
+#define ACCL_WS_DEFLATE_OFFERED		2		/* waiting for the portal */
+#define ACCL_WS_DEFLATE_ACCEPTED	3		/* streams initialized */
+#define ACCL_WS_DEFLATE_INFLATING	4		/* client stream failed, portal one kept */
+
+struct accl_ws_deflate {
+	int state;								/* ACCL_WS_DEFLATE_* */
+	int window_bits;						/* client messages */
+	int mem_level;
+	z_stream out;							/* client messages */
+	z_stream in;							/* portal messages */
+	struct accl_ws_message frame;			/* deflated message being written */
+	unsigned char* buffer;					/* frame data, behind the padding */
+	size_t capacity;
+	unsigned char* inflated;				/* last portal message inflated */
+	size_t inflated_capacity;
+	unsigned char offer[LWS_SEND_BUFFER_PRE_PADDING + 2 + LWS_SEND_BUFFER_POST_PADDING];
+};
+
+/* user_context->mutex held */
+static void acclWebSocketPendingAdd(struct accl_context_buffer* user_context, struct accl_ws_exchange* exchange) {
+	struct accl_ws_exchange** bucket = &user_context->pending[exchange->id & (ACCL_WS_PENDING_BUCKETS - 1)];
+
+	exchange->next = *bucket;
+	*bucket = exchange;
+	user_context->pending_count++;
+}
+
+/* user_context->mutex held; link to the exchange with the given id */
+static struct accl_ws_exchange** acclWebSocketPendingFind(struct accl_context_buffer* user_context, const unsigned int id) {
+	struct accl_ws_exchange** link = &user_context->pending[id & (ACCL_WS_PENDING_BUCKETS - 1)];
+
+	while (NULL != *link && (*link)->id != id)
+		link = &(*link)->next;
+
+	return link;
+}
+
+/* user_context->mutex held; unlinks the exchange with the given id */
+static struct accl_ws_exchange* acclWebSocketPendingTake(struct accl_context_buffer* user_context, const unsigned int id) {
+	struct accl_ws_exchange** link = acclWebSocketPendingFind(user_context, id);
+	struct accl_ws_exchange* exchange = *link;
+
+	if (NULL != exchange) {
+		*link = exchange->next;
+		user_context->pending_count--;
+	}
+
+	return exchange;
+}
+
+/*
+	Pending exchange a server message answers, NULL for server initiated
+	messages; header receives the size of the tag in front of the response.
+	user_context->mutex held
+*/
+static struct accl_ws_exchange* acclWebSocketMatch(struct accl_context_buffer* user_context, const unsigned char* in, const size_t len, size_t* header) {
+	unsigned int id = 0;
+
+	*header = 0;
+
+	if (ACCL_WS_MULTIPLEX) {
+		if (len < ACCL_WS_TAG_SIZE || ACCL_WS_TAGGED_EXCHANGE != in[0])
+			return NULL;
+
+		id = ((unsigned int)in[1] << 24) | ((unsigned int)in[2] << 16) | ((unsigned int)in[3] << 8) | in[4];
+		*header = ACCL_WS_TAG_SIZE;
+	}
+
+	return acclWebSocketPendingTake(user_context, id);
+}
+
+/*
+	Fails every pending exchange of a closed channel; user_context->mutex held
+*/
+static void acclWebSocketPendingFail(struct accl_context_buffer* user_context, const int status) {
+	struct accl_ws_exchange* exchange;
+	unsigned int i;
+
+	for (i = 0; i < ACCL_WS_PENDING_BUCKETS; i++) {
+		while (NULL != (exchange = user_context->pending[i])) {
+			user_context->pending[i] = exchange->next;
+
+			exchange->status = status;
+			pthread_cond_signal(&exchange->done);
+		}
+	}
+
+	user_context->pending_count = 0;
+}
+
+/*
+	Outgoing message of size bytes, type and header in front of the
+	payload, between the paddings libwebsockets needs
+*/
+static struct accl_ws_message* acclWebSocketMessageCreate(const int type, const unsigned int header, const char* payload, const unsigned int size) {
+	struct accl_ws_message* message = (struct accl_ws_message*)malloc(sizeof(struct accl_ws_message) +
+		LWS_SEND_BUFFER_PRE_PADDING + header + size + LWS_SEND_BUFFER_POST_PADDING);
+
+	if (NULL == message)
+		return NULL;
+
+	message->next = NULL;
+	message->data = (unsigned char*)(message + 1) + LWS_SEND_BUFFER_PRE_PADDING;
+	message->size = header + size;
+
+	// the first byte is used to identify the type of call (see ACCL_WS_SEND)
+	message->data[0] = (unsigned char)type;
+
+	memcpy(message->data + header, payload, size);
+
+	return message;
+}
+
+/* request id of a tagged exchange message */
+static void acclWebSocketTag(struct accl_ws_message* message, const unsigned int id) {
+	message->data[1] = (unsigned char)(id >> 24);
+	message->data[2] = (unsigned char)(id >> 16);
+	message->data[3] = (unsigned char)(id >> 8);
+	message->data[4] = (unsigned char)id;
+}
+
+/*
+	Outbound queue: an intrusive multi-producer single-consumer list,
+	application threads push with one atomic exchange and the service
+	thread pops from the head; the stub keeps the list non-empty
+*/
+static void acclWebSocketQueueInit(struct accl_context_buffer* user_context) {
+	user_context->queue_stub.next = NULL;
+	user_context->queue_head = &user_context->queue_stub;
+	user_context->queue_tail = &user_context->queue_stub;
+}
+
+static void acclWebSocketQueuePush(struct accl_context_buffer* user_context, struct accl_ws_message* message) {
+	struct accl_ws_message* previous;
+
+	__atomic_store_n(&message->next, NULL, __ATOMIC_RELAXED);
+	previous = __atomic_exchange_n(&user_context->queue_tail, message, __ATOMIC_ACQ_REL);
+
+	// the consumer sees the message once linked
+	__atomic_store_n(&previous->next, message, __ATOMIC_RELEASE);
+}
+
+/* service thread; NULL when empty, or while the next push is half done */
+static struct accl_ws_message* acclWebSocketQueuePop(struct accl_context_buffer* user_context) {
+	struct accl_ws_message* head = user_context->queue_head;
+	struct accl_ws_message* next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+
+	if (&user_context->queue_stub == head) {
+		if (NULL == next)
+			return NULL;
+
+		user_context->queue_head = next;
+		head = next;
+		next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+	}
+
+	if (NULL != next) {
+		user_context->queue_head = next;
+		return head;
+	}
+
+	if (head != __atomic_load_n(&user_context->queue_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	// last message: the stub takes its place
+	acclWebSocketQueuePush(user_context, &user_context->queue_stub);
+	next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+
+	if (NULL != next) {
+		user_context->queue_head = next;
+		return head;
+	}
+
+	return NULL;
+}
+
+/* service thread */
+static int acclWebSocketQueueEmpty(struct accl_context_buffer* user_context) {
+	struct accl_ws_message* head = user_context->queue_head;
+
+	return (&user_context->queue_stub == head && NULL == __atomic_load_n(&head->next, __ATOMIC_ACQUIRE));
+}
+
+/*
+	Accounts size bytes to the channel queue, waiting or failing over the
+	technique budget; an empty queue always takes one message
+*/
+static int acclWebSocketQueueReserve(struct accl_context_buffer* user_context, const size_t size) {
+	size_t queued = __atomic_load_n(&user_context->queued_bytes, __ATOMIC_SEQ_CST);
+	int returnValue = ACCL_SUCCESS;
+
+	if (queued > 0 && queued + size > user_context->queue_budget) {
+		if (ACCL_WS_BACKPRESSURE_FAIL == user_context->backpressure)
+			return ACCL_WS_QUEUE_FULL;
+
+		pthread_mutex_lock(&user_context->mutex);
+		__atomic_add_fetch(&user_context->queue_waiters, 1, __ATOMIC_SEQ_CST);
+
+		while (2 != user_context->initialization_complete &&
+				(queued = __atomic_load_n(&user_context->queued_bytes, __ATOMIC_SEQ_CST)) > 0 &&
+				queued + size > user_context->queue_budget)
+			pthread_cond_wait(&user_context->done, &user_context->mutex);
+
+		__atomic_sub_fetch(&user_context->queue_waiters, 1, __ATOMIC_SEQ_CST);
+
+		if (2 == user_context->initialization_complete)
+			returnValue = ACCL_WS_ALREADY_SHUT_DOWN;
+
+		pthread_mutex_unlock(&user_context->mutex);
+
+		if (ACCL_SUCCESS != returnValue)
+			return returnValue;
+	}
+
+	__atomic_add_fetch(&user_context->queued_bytes, size, __ATOMIC_SEQ_CST);
+
+	return ACCL_SUCCESS;
+}
+
+/* gives size queued bytes back, waking the senders waiting for room */
+static void acclWebSocketQueueRelease(struct accl_context_buffer* user_context, const size_t size) {
+	__atomic_sub_fetch(&user_context->queued_bytes, size, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&user_context->queue_waiters, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&user_context->mutex);
+		pthread_cond_broadcast(&user_context->done);
+		pthread_mutex_unlock(&user_context->mutex);
+	}
+}
+
+static void acclWebSocketMessageFree(struct accl_context_buffer* user_context, struct accl_ws_message* message) {
+	acclWebSocketQueueRelease(user_context, message->size);
+	free(message);
+}
+
+/*
+	Pending exchanges of a dropped connection: those still queued leave
+	with the queue, those picked for writing are queued again from the
+	caller request when the technique is idempotent and fail with
+	ACCL_WS_CONNECTION_LOST otherwise; user_context->mutex held, service
+	thread
+*/
+static void acclWebSocketPendingRetry(struct accl_context_buffer* user_context) {
+	struct accl_ws_exchange** link;
+	struct accl_ws_exchange* exchange;
+	struct accl_ws_message* message;
+	unsigned int i;
+
+	for (i = 0; i < ACCL_WS_PENDING_BUCKETS; i++) {
+		link = &user_context->pending[i];
+
+		while (NULL != (exchange = *link)) {
+			if (!exchange->written) {
+				link = &exchange->next;
+				continue;
+			}
+
+			exchange->written = 0;
+			message = NULL;
+
+			if (user_context->reissue)
+				message = acclWebSocketMessageCreate(ACCL_WS_MULTIPLEX ? ACCL_WS_TAGGED_EXCHANGE : ACCL_WS_EXCHANGE,
+					ACCL_WS_MULTIPLEX ? ACCL_WS_TAG_SIZE : 1, exchange->payload, exchange->payload_size);
+
+			if (NULL != message) {
+				if (ACCL_WS_MULTIPLEX)
+					acclWebSocketTag(message, exchange->id);
+
+				// accounted over the budget: the sender reserved its room once already
+				__atomic_add_fetch(&user_context->queued_bytes, message->size, __ATOMIC_SEQ_CST);
+				acclWebSocketQueuePush(user_context, message);
+
+				link = &exchange->next;
+			} else {
+				*link = exchange->next;
+				user_context->pending_count--;
+
+				exchange->status = ACCL_WS_CONNECTION_LOST;
+				pthread_cond_signal(&exchange->done);
+			}
+		}
+	}
+}
+
+/*
+	Picks the next message to write; a run of small queued messages is
+	coalesced in one ACCL_WS_BATCH frame; service thread
+*/
+static void acclWebSocketNext(struct accl_context_buffer* user_context) {
+	struct accl_ws_message* message = user_context->next_message;
+	struct accl_ws_message* other;
+	unsigned char* batch;
+	size_t size, coalesced = 0;
+
+	if (NULL == message)
+		message = acclWebSocketQueuePop(user_context);
+
+	user_context->next_message = NULL;
+	user_context->sending = message;
+	user_context->send_offset = 0;
+
+	if (!ACCL_WS_COALESCE || NULL == message || message->size > ACCL_WS_COALESCE_LIMIT)
+		return;
+
+	other = acclWebSocketQueuePop(user_context);
+
+	if (NULL == other)
+		return;
+
+	if (other->size > ACCL_WS_COALESCE_LIMIT ||
+			1 + 2 * ACCL_WS_BATCH_HEADER + message->size + other->size > ACCL_MAX_WS_BUFFER_SIZE) {
+		user_context->next_message = other;
+		return;
 	}
-	
-	if ((time_t)-1 == time(&now)) {
-		fprintf(stderr, "ERROR: Unable to retrieve current time.log\n");
-		fclose(fp);
-		return;	
-	}
-  	fprintf(fp, "%.24s [%s] ", ctime(&now), tag);
-
-	va_start(ap, lvl);                         /* must be called before work */
-  
-	while (*fmt) {
-		for (j = 0; fmt[j] && fmt[j] != '%'; j++)
-			format[j] = fmt[j];                    /* not a format string          */
-		
-		if (j) {
-			format[j] = '\0';
-			count += fprintf(fp, format, "");    /* log it verbatim              */
-			fmt += j;
-		} else {
-			for (j = 0; !isalpha(fmt[j]); j++) {   /* find end of format specifier */
-				format[j] = fmt[j];
-				if (j && fmt[j] == '%')              /* special case printing '%'    */
+
+	if (NULL == user_context->send_buffer) {
+		user_context->send_buffer = (unsigned char*)malloc(LWS_SEND_BUFFER_PRE_PADDING +
+			ACCL_MAX_WS_BUFFER_SIZE + LWS_SEND_BUFFER_POST_PADDING);
+
+		if (NULL == user_context->send_buffer) {
+			user_context->next_message = other;
+			return;
+		}
+	}
+
+	batch = user_context->send_buffer + LWS_SEND_BUFFER_PRE_PADDING;
+	batch[0] = ACCL_WS_BATCH;
+	size = 1;
+
+	while (NULL != message) {
+		if (message->size > ACCL_WS_COALESCE_LIMIT ||
+				size + ACCL_WS_BATCH_HEADER + message->size > ACCL_MAX_WS_BUFFER_SIZE) {
+			user_context->next_message = message;
+			break;
+		}
+
+		batch[size] = (unsigned char)(message->size >> 24);
+		batch[size + 1] = (unsigned char)(message->size >> 16);
+		batch[size + 2] = (unsigned char)(message->size >> 8);
+		batch[size + 3] = (unsigned char)message->size;
+		memcpy(batch + size + ACCL_WS_BATCH_HEADER, message->data, message->size);
+
+		size += ACCL_WS_BATCH_HEADER + message->size;
+		coalesced += message->size;
+		free(message);
+
+		message = (NULL != other) ? other : acclWebSocketQueuePop(user_context);
+		other = NULL;
+	}
+
+	user_context->batch.data = batch;
+	user_context->batch.size = size;
+	user_context->sending = &user_context->batch;
+
+	acclWebSocketQueueRelease(user_context, coalesced);
+}
+
+static void acclWebSocketDeflateReset(struct accl_ws_deflate* codec) {
+	if (ACCL_WS_DEFLATE_ACCEPTED == codec->state)
+		deflateEnd(&codec->out);
+
+	if (ACCL_WS_DEFLATE_ACCEPTED == codec->state || ACCL_WS_DEFLATE_INFLATING == codec->state)
+		inflateEnd(&codec->in);
+
+	codec->state = ACCL_WS_DEFLATE_OFF;
+}
+
+/*
+	Portal answer to the deflate offer: the window bits it compresses
+	with, out of range when it declines
+*/
+static void acclWebSocketDeflateAccept(struct accl_context_buffer* user_context, const unsigned char* in, const size_t len) {
+	struct accl_ws_deflate* codec = user_context->deflate;
+	int window_bits = (2 == len) ? in[1] : 0;
+
+	codec->state = ACCL_WS_DEFLATE_OFF;
+
+	if (window_bits < 9 || window_bits > 15)
+		return;
+
+	memset(&codec->out, 0, sizeof(codec->out));
+	memset(&codec->in, 0, sizeof(codec->in));
+
+	// negative windowBits: raw deflate, the streams span the whole connection
+	if (Z_OK != deflateInit2(&codec->out, acclCompressionLevel(&user_context->client->compression), Z_DEFLATED,
+			-codec->window_bits, codec->mem_level, Z_DEFAULT_STRATEGY))
+		return;
+
+	if (Z_OK != inflateInit2(&codec->in, -window_bits)) {
+		deflateEnd(&codec->out);
+		return;
+	}
+
+	codec->state = ACCL_WS_DEFLATE_ACCEPTED;
+
+#ifndef NDEBUG
+	lwsl_notice("ACCL: per-message deflate accepted (TID: %d, window bits %d/%d)\n",
+		user_context->technique_id, codec->window_bits, window_bits);
+#endif
+}
+
+/*
+	Message as written on the connection: deflated once the portal
+	accepted, unless too small to gain anything; service thread
+*/
+static struct accl_ws_message* acclWebSocketDeflate(struct accl_context_buffer* user_context, struct accl_ws_message* message) {
+	struct accl_ws_deflate* codec = user_context->deflate;
+	unsigned char* grown;
+	size_t size = 1, capacity;
+	int res = Z_OK;
+
+	if (NULL == codec || ACCL_WS_DEFLATE_ACCEPTED != codec->state || message->size < ACCL_WS_DEFLATE_THRESHOLD)
+		return message;
+
+	codec->out.next_in = message->data;
+	codec->out.avail_in = (uInt)message->size;
+
+	while (Z_OK == res) {
+		// sync flush output can exceed the bound a little
+		capacity = size + deflateBound(&codec->out, codec->out.avail_in) + 16;
+
+		if (capacity > codec->capacity) {
+			grown = (unsigned char*)realloc(codec->buffer,
+				LWS_SEND_BUFFER_PRE_PADDING + capacity + LWS_SEND_BUFFER_POST_PADDING);
+
+			if (NULL == grown) {
+				res = Z_MEM_ERROR;
 				break;
 			}
-		
-			format[j] = fmt[j];                    /* finish writing specifier     */
-			format[j + 1] = '\0';                  /* don't forget NULL terminator */
-			fmt += j + 1;
-			
-			switch (format[j]) {                   /* cases for all specifiers     */
-			case 'd':
-			case 'i':                              /* many use identical actions   */
-				i = va_arg(ap, int);                 /* process the argument         */
-				count += fprintf(fp, format, i); /* and log it                 */
-				break;
-			case 'o':
-			case 'x':
-			case 'X':
-			case 'u':
-				u = va_arg(ap, unsigned);
-				count += fprintf(fp, format, u);
-				break;
-			case 'c':
-				c = (char) va_arg(ap, int);          /* must cast!  */
-				count += fprintf(fp, format, c);
-				break;
-			case 's':
-				s = va_arg(ap, char *);
-				count += fprintf(fp, format, s);
-				break;
-			case 'f':
-			case 'e':
-			case 'E':
-			case 'g':
-			case 'G':
-				d = va_arg(ap, double);
-				count += fprintf(fp, format, d);
-				break;
-			case 'p':
-				v = va_arg(ap, void *);
-				count += fprintf(fp, format, v);
-				break;
-			case 'n':
-				count += fprintf(fp, "%d", count);
-				break;
-			case '%':
-				count += fprintf(fp, "%%");
-				break;
-			default:
-				fprintf(stderr, "Invalid format specifier in acclLOG().\n");
+
+			codec->buffer = grown;
+			codec->capacity = capacity;
+		}
+
+		codec->out.next_out = codec->buffer + LWS_SEND_BUFFER_PRE_PADDING + size;
+		codec->out.avail_out = (uInt)(codec->capacity - size);
+
+		res = deflate(&codec->out, Z_SYNC_FLUSH);
+		size = codec->capacity - codec->out.avail_out;
+
+		// room left: everything is flushed
+		if (0 != codec->out.avail_out)
+			break;
+	}
+
+	if (Z_OK != res || 0 != codec->out.avail_in || size < 1 + 4) {
+		// the portal cannot follow our stream any more: plain messages from
+		// now on, while its own deflated messages are still inflated
+#ifndef NDEBUG
+		lwsl_err("ACCL: per-message deflate failed (TID: %d)\n", user_context->technique_id);
+#endif
+		deflateEnd(&codec->out);
+		codec->state = ACCL_WS_DEFLATE_INFLATING;
+		return message;
+	}
+
+	codec->frame.data = codec->buffer + LWS_SEND_BUFFER_PRE_PADDING;
+	codec->frame.data[0] = ACCL_WS_DEFLATED;
+
+	// the receiver adds the sync flush trailer back
+	codec->frame.size = size - 4;
+
+	return &codec->frame;
+}
+
+/*
+	Inflates an ACCL_WS_DEFLATED portal message into the deflate buffer,
+	0 when the stream is broken; service thread
+*/
+static int acclWebSocketInflate(struct accl_context_buffer* user_context, const unsigned char* in, const size_t len, size_t* size) {
+	static const unsigned char trailer[4] = { 0x00, 0x00, 0xff, 0xff };
+	struct accl_ws_deflate* codec = user_context->deflate;
+	unsigned char* grown;
+	size_t capacity;
+	int res;
+	int i;
+
+	*size = 0;
+
+	for (i = 0; i < 2; i++) {
+		codec->in.next_in = (Bytef*)((0 == i) ? in + 1 : trailer);
+		codec->in.avail_in = (uInt)((0 == i) ? len - 1 : sizeof(trailer));
+
+		do {
+			if (*size == codec->inflated_capacity) {
+				capacity = MAX(codec->inflated_capacity * 2, (size_t)ACCL_MAX_WS_BUFFER_SIZE);
+
+				// bounded like any other response
+				if (capacity > (size_t)ACCL_MAX_BUFFER_SIZE * 2)
+					return 0;
+
+				grown = (unsigned char*)realloc(codec->inflated, capacity);
+
+				if (NULL == grown)
+					return 0;
+
+				codec->inflated = grown;
+				codec->inflated_capacity = capacity;
+			}
+
+			codec->in.next_out = codec->inflated + *size;
+			codec->in.avail_out = (uInt)(codec->inflated_capacity - *size);
+
+			res = inflate(&codec->in, Z_SYNC_FLUSH);
+			*size = codec->inflated_capacity - codec->in.avail_out;
+
+			// a final block ends the stream, the next message starts a new one
+			if (Z_STREAM_END == res)
+				res = inflateReset(&codec->in);
+
+			if (Z_OK != res && Z_BUF_ERROR != res)
+				return 0;
+		} while (0 != codec->in.avail_in || 0 == codec->in.avail_out);
+	}
+
+	return 1;
+}
+
+/*
+	Marks the exchanges carried by a message picked for writing, before
+	libwebsockets masks it in place: after a drop, the portal may have
+	processed them; service thread
+*/
+static void acclWebSocketWritten(struct accl_context_buffer* user_context, const unsigned char* data, const size_t size) {
+	struct accl_ws_exchange* exchange;
+	size_t offset, length;
+	unsigned int id = 0;
+
+	if (0 == size)
+		return;
+
+	if (ACCL_WS_BATCH == data[0]) {
+		for (offset = 1; offset + ACCL_WS_BATCH_HEADER <= size; offset += ACCL_WS_BATCH_HEADER + length) {
+			length = ((size_t)data[offset] << 24) | ((size_t)data[offset + 1] << 16) |
+				((size_t)data[offset + 2] << 8) | data[offset + 3];
+			acclWebSocketWritten(user_context, data + offset + ACCL_WS_BATCH_HEADER, length);
+		}
+
+		return;
+	}
+
+	if (ACCL_WS_SEND == data[0])
+		return;
+
+	if (ACCL_WS_TAGGED_EXCHANGE == data[0] && size >= ACCL_WS_TAG_SIZE)
+		id = ((unsigned int)data[1] << 24) | ((unsigned int)data[2] << 16) | ((unsigned int)data[3] << 8) | data[4];
+
+	pthread_mutex_lock(&user_context->mutex);
+	exchange = *acclWebSocketPendingFind(user_context, id);
+
+	if (NULL != exchange)
+		exchange->written = 1;
+
+	pthread_mutex_unlock(&user_context->mutex);
+}
+
+/*
+	Hands a complete server message to the exchange waiting for it or,
+	when none is, to the technique callback; -1 when the connection is
+	to be closed
+*/
+static int acclWebSocketDeliver(struct accl_context_buffer* user_context, void* in, size_t len) {
+	void* (* callback)(void*, size_t);
+	struct accl_ws_deflate* codec = user_context->deflate;
+	struct accl_ws_exchange* exchange;
+	size_t header;
+
+	if (NULL != codec && len > 0) {
+		if (ACCL_WS_DEFLATE_OFFERED == codec->state && ACCL_WS_DEFLATE_OFFER == *(unsigned char*)in) {
+			acclWebSocketDeflateAccept(user_context, (unsigned char*)in, len);
+			return 0;
+		}
+
+		if ((ACCL_WS_DEFLATE_ACCEPTED == codec->state || ACCL_WS_DEFLATE_INFLATING == codec->state) &&
+				ACCL_WS_DEFLATED == *(unsigned char*)in) {
+			if (!acclWebSocketInflate(user_context, (unsigned char*)in, len, &len)) {
+#ifndef NDEBUG
+				lwsl_err("ACCL: corrupted deflated message (TID: %d)\n", user_context->technique_id);
+#endif
+				// the stream cannot be resynchronized, a new connection starts a new one
+				return -1;
 			}
+
+			in = codec->inflated;
 		}
 	}
-	
-	fprintf(fp, "\n");
-	
-	va_end(ap);  // clean up
-		
-	fclose(fp);
+
+	pthread_mutex_lock(&user_context->mutex);
+	exchange = acclWebSocketMatch(user_context, (unsigned char*)in, len, &header);
+	pthread_mutex_unlock(&user_context->mutex);
+
+	if (NULL != exchange) {
+#ifndef NDEBUG
+		lwsl_notice("RECEIVED EXCHANGE RESPONSE FROM SERVER (request %u)\n", exchange->id);
+#endif
+		len -= header;
+
+		// the waiting thread does not touch its buffer until signalled
+		if (len <= exchange->capacity)
+			memcpy(exchange->buffer, (char*)in + header, len);
+#ifndef NDEBUG
+		else
+			lwsl_err("Exchange response buffer (%d bytes) too small: received (%d bytes)\n", exchange->capacity, (int)len);
+#endif
+
+		pthread_mutex_lock(&user_context->mutex);
+		exchange->size = (unsigned int)len;
+		exchange->status = (len <= exchange->capacity) ? ACCL_SUCCESS : ACCL_OUTPUT_BUFFER_MAX_SIZE_EXCEEDED;
+		pthread_cond_signal(&exchange->done);
+
+		// untagged exchanges queue up behind the one just answered
+		if (!ACCL_WS_MULTIPLEX)
+			pthread_cond_broadcast(&user_context->done);
+
+		pthread_mutex_unlock(&user_context->mutex);
+	} else {
+#ifndef NDEBUG
+		lwsl_notice("ACCL - Data received from server, invoking the callback\n");
+#endif
+		// warmed up channels have no callback until claimed
+		callback = __atomic_load_n(&user_context->callback, __ATOMIC_ACQUIRE);
+
+		if (NULL != callback)
+			callback(in, len);
+	}
+
+	return 0;
+}
+
+/*
+	Frees a channel and gives its slot back; service->mutex held
+*/
+static void acclWebSocketChannelFree(struct accl_context_buffer* user_context) {
+	accl_ws_service* service = user_context->service;
+	struct accl_ws_message* message;
+
+	service->channels[user_context->slot] = NULL;
+	service->channel_count--;
+
+	if (user_context->portal >= 0)
+		acclPortalRelease(&user_context->client->ws_portals, user_context->portal, ACCL_FAILURE_FINAL, 0);
+
+	// messages never written
+	if (NULL != user_context->sending && &user_context->batch != user_context->sending)
+		free(user_context->sending);
+
+	free(user_context->next_message);
+
+	while (NULL != (message = acclWebSocketQueuePop(user_context)))
+		free(message);
+
+	if (NULL != user_context->deflate) {
+		acclWebSocketDeflateReset(user_context->deflate);
+		free(user_context->deflate->buffer);
+		free(user_context->deflate->inflated);
+		free(user_context->deflate);
+	}
+
+	pthread_cond_destroy(&user_context->done);
+	pthread_mutex_destroy(&user_context->mutex);
+	free(user_context->send_buffer);
+	free(user_context->receive_buffer);
+	free(user_context);
+}
+
+/*
+	Drops a reference to a channel, its handle or a call in flight; the
+	last one frees it
+*/
+static void acclWebSocketChannelPut(struct accl_context_buffer* user_context) {
+	accl_ws_service* service = user_context->service;
+
+	if (0 != __atomic_sub_fetch(&user_context->references, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	pthread_mutex_lock(&service->mutex);
+	acclWebSocketChannelFree(user_context);
+	pthread_mutex_unlock(&service->mutex);
 }
-#endif
 
-/* 
-	ASPIRE CLIENT COMMUNICATION LOGIC - WEBSOCKET PROTOCOL
-	
+/*
+	The connection of a channel is gone (or was never made). A channel
+	that was open is reconnected after a backoff, keeping its queue;
+	otherwise, or once out of attempts, waiting senders and exchangers
+	give up and an orphaned channel is freed; service thread
 */
+static void acclWebSocketClosed(struct accl_context_buffer* user_context) {
+	accl_ws_service* service = user_context->service;
+	accl_retry_policy policy;
+	int stopping, reconnect;
+	int orphaned;
+
+	pthread_mutex_lock(&service->mutex);
+	stopping = service->stopping;
+	pthread_mutex_unlock(&service->mutex);
+
+	if (user_context->portal >= 0) {
+		acclPortalRelease(&user_context->client->ws_portals, user_context->portal, ACCL_FAILURE_FINAL, 0);
+		user_context->portal = -1;
+	}
 
-#ifndef WITHOUT_WEBSOCKETS
+	// libwebsockets masked what it wrote of the message in place: it is
+	// dropped, its exchanges go again from their caller requests
+	if (NULL != user_context->sending && &user_context->batch != user_context->sending)
+		acclWebSocketMessageFree(user_context, user_context->sending);
 
-/* array containing spawned WS loop threads */
-//ws_channel accl_ws_tids[ACCL_MAX_WS_THREADS];
+	user_context->sending = NULL;
+	user_context->writing = NULL;
+	user_context->send_offset = 0;
 
-/* array containing connections status */
-int accl_ws_connections_status[ACCL_MAX_WS_THREADS];
+	if (NULL != user_context->deflate)
+		acclWebSocketDeflateReset(user_context->deflate);
+	user_context->receive_size = 0;
+	user_context->wsi = NULL;
 
-/* index of the first available WS channel slot */
-//static int current_ws_tid = 0;
+	pthread_mutex_lock(&user_context->mutex);
 
-/* list of supported protocols and callbacks */
-static struct libwebsocket_protocols protocols[] = {
-	{
-		"accl-communication-protocol",
-		callback_accl_communication,
-		sizeof(int),
-	},
-	{  
-		/* end of list */
-		NULL,
-		NULL,
-		0
+	// a reconnection attempt that failed: the next one may pick another host
+	if (user_context->opened && 0 == user_context->initialization_complete)
+		acclPortalDown(&user_context->client->ws_portals, user_context->node);
+
+	reconnect = user_context->opened && !user_context->closing && !stopping &&
+		user_context->reconnect_attempt < ACCL_WS_RECONNECT_ATTEMPTS;
+
+	if (reconnect) {
+		if (1 == user_context->initialization_complete)
+			acclWebSocketPendingRetry(user_context);
+
+		__atomic_store_n(&user_context->initialization_complete, 0, __ATOMIC_RELEASE);
+		user_context->reconnect_attempt++;
+
+		policy.backoff = user_context->reconnect_backoff;
+		policy.max_backoff = user_context->reconnect_max_backoff;
+		user_context->reconnect_at = acclNow() +
+			(unsigned long long)acclRetryBackoff(&policy, user_context->reconnect_attempt) * 1000;
+
+#ifndef NDEBUG
+		lwsl_notice("ACCL: channel (TID: %d) dropped, reconnection attempt %u\n",
+			user_context->technique_id, user_context->reconnect_attempt);
+#endif
+	} else {
+		__atomic_store_n(&user_context->initialization_complete, 2, __ATOMIC_RELEASE);
+		user_context->reconnect_at = 0;
+		acclWebSocketPendingFail(user_context, (user_context->opened && !user_context->closing && !stopping) ?
+			ACCL_WS_CONNECTION_LOST : ACCL_WS_ALREADY_SHUT_DOWN);
 	}
-};
+
+	orphaned = user_context->orphaned;
+	pthread_cond_broadcast(&user_context->done);
+	pthread_mutex_unlock(&user_context->mutex);
+
+	// callers woken above may still be on their way out
+	if (!reconnect && orphaned)
+		acclWebSocketChannelPut(user_context);
+}
 
 /* general callback for websockets events */
 int callback_accl_communication(
@@ -668,21 +5639,20 @@ int callback_accl_communication(
 	size_t len)
 {
 	int m;
-
-	struct accl_context_buffer* user_context = 0;
-
-	if (NULL != this) {
-		user_context = (struct accl_context_buffer*)libwebsocket_context_user(this);
-	} else {
-
-	}
-
-	// output buffer has to be pre and post padded
-	// [ ... PRE-PADDING ... | ACTUAL BUFFER CONTENT | ... POST-PADDING ... ]
-	unsigned char write_buffer[LWS_SEND_BUFFER_PRE_PADDING + ACCL_MAX_WS_BUFFER_SIZE + LWS_SEND_BUFFER_POST_PADDING];
-
-	// pointer to output buffer actual start offset
-	unsigned char *write_buffer_pointer = &write_buffer[LWS_SEND_BUFFER_PRE_PADDING];
+	int write_protocol;
+	int complete;
+	unsigned char* write_buffer_pointer;
+	unsigned char* grown;
+	size_t capacity;
+	unsigned char post_padding[LWS_SEND_BUFFER_POST_PADDING];
+	size_t fragment;
+
+	// every connection of the client context carries its channel
+	struct accl_context_buffer* user_context = (struct accl_context_buffer*)user;
+	int closing;
+
+	if (NULL == user_context)
+		return 0;
 
 	switch (reason) {
 		case LWS_CALLBACK_CLIENT_ESTABLISHED:
@@ -690,20 +5660,42 @@ int callback_accl_communication(
 			/* connection has been established */
 			lwsl_notice("ACCL: LWS_CALLBACK_CLIENT_ESTABLISHED\n");
 #endif
-			user_context->initialization_complete = 1;
+			// the channel counts as outstanding on its host until it drops,
+			// health checks probe the host on its port
+			user_context->portal = user_context->node;
+			acclPortalAcquire(&user_context->client->ws_portals, user_context->node);
+			__atomic_store_n(&user_context->client->ws_portals.nodes[user_context->node].port,
+				acclGetWebSocketPort(user_context->technique_id), __ATOMIC_RELAXED);
+
+			user_context->opened = 1;
+			user_context->reconnect_attempt = 0;
+
+			// the streams of a connection start with it
+			if (NULL != user_context->deflate)
+				user_context->deflate->state = ACCL_WS_DEFLATE_OFFERING;
+
+			pthread_mutex_lock(&user_context->mutex);
+			__atomic_store_n(&user_context->initialization_complete, 1, __ATOMIC_RELEASE);
+			closing = user_context->closing;
+			pthread_cond_broadcast(&user_context->done);
+			pthread_mutex_unlock(&user_context->mutex);
+
+			// shut down while connecting: closed from the writeable callback;
+			// reconnected: the messages retained meanwhile go out
+			if (closing || NULL != user_context->deflate || NULL != user_context->sending ||
+					NULL != user_context->next_message || !acclWebSocketQueueEmpty(user_context))
+				libwebsocket_callback_on_writable(this, wsi);
 
 			break;
 		case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
-#ifndef NDEBUG
-			lwsl_err("ACCL: LWS_CALLBACK_CLIENT_CONNECTION_ERROR (TID: %d)\n", user_context->technique_id);
-#endif
-			user_context->initialization_complete = 2;
-
-			break;
 		case LWS_CALLBACK_CLOSED:
 #ifndef NDEBUG
-			lwsl_err("ACCL: LWS_CALLBACK_CLOSED (TID: %d)\n", user_context->technique_id);
+			lwsl_err("ACCL: %s (TID: %d)\n",
+				(LWS_CALLBACK_CLOSED == reason) ? "LWS_CALLBACK_CLOSED" : "LWS_CALLBACK_CLIENT_CONNECTION_ERROR",
+				user_context->technique_id);
 #endif
+			acclWebSocketClosed(user_context);
+
 			break;
 		case LWS_CALLBACK_CLIENT_WRITEABLE:
 
@@ -721,10 +5713,41 @@ int callback_accl_communication(
 				return 0;
 			}
 
-			if (0 == user_context->buffer_size)
-				return 0;
+			// deflate is offered before anything else, messages are not held back meanwhile
+			if (NULL != user_context->deflate && ACCL_WS_DEFLATE_OFFERING == user_context->deflate->state) {
+				write_buffer_pointer = user_context->deflate->offer + LWS_SEND_BUFFER_PRE_PADDING;
+				write_buffer_pointer[0] = ACCL_WS_DEFLATE_OFFER;
+				write_buffer_pointer[1] = (unsigned char)user_context->deflate->window_bits;
+
+				if (libwebsocket_write(wsi, write_buffer_pointer, 2, LWS_WRITE_BINARY) < 2)
+					return -1;
+
+				user_context->deflate->state = ACCL_WS_DEFLATE_OFFERED;
+				libwebsocket_callback_on_writable(this, wsi);
+
+				break;
+			}
+
+			if (NULL == user_context->sending) {
+				acclWebSocketNext(user_context);
+
+				if (NULL != user_context->sending)
+					acclWebSocketWritten(user_context, user_context->sending->data, user_context->sending->size);
+			}
+
+			if (NULL == user_context->sending) {
+				pthread_mutex_lock(&user_context->mutex);
+				closing = user_context->closing;
+				pthread_mutex_unlock(&user_context->mutex);
+
+				// acclWebSocketShutdown: libwebsockets closes the drained connection
+				return closing ? -1 : 0;
+			}
+			if (NULL == user_context->writing)
+				user_context->writing = acclWebSocketDeflate(user_context, user_context->sending);
 #ifndef NDEBUG
-			lwsl_notice("ACCL: LWS_CALLBACK_CLIENT_WRITEABLE (%d bytes to transmit)\n", user_context->buffer_size);
+			lwsl_notice("ACCL: LWS_CALLBACK_CLIENT_WRITEABLE (%d of %d bytes to transmit)\n",
+				(int)(user_context->writing->size - user_context->send_offset), (int)user_context->writing->size);
 #endif
 			/**
 			 * Outgoing data can be:
@@ -733,21 +5756,47 @@ int callback_accl_communication(
 			 * - client initiated Send
 			 */
 
-			// fill in the padded output buffer
-			memcpy (write_buffer_pointer, user_context->buffer_ptr, user_context->buffer_size);
+			// the message sits in its padded buffer already: one fragment per callback
+			fragment = MIN(user_context->writing->size - user_context->send_offset, (size_t)ACCL_MAX_WS_BUFFER_SIZE);
+			write_buffer_pointer = user_context->writing->data + user_context->send_offset;
+
+			write_protocol = (0 == user_context->send_offset) ? LWS_WRITE_BINARY : LWS_WRITE_CONTINUATION;
+
+			if (user_context->send_offset + fragment < user_context->writing->size)
+				write_protocol |= LWS_WRITE_NO_FIN;
+
+			// the post padding of an inner fragment is the start of the next one
+			memcpy(post_padding, write_buffer_pointer + fragment, LWS_SEND_BUFFER_POST_PADDING);
 
 			// send data though the channel
-			m = libwebsocket_write(wsi, write_buffer_pointer, user_context->buffer_size, LWS_WRITE_BINARY);
+			m = libwebsocket_write(wsi, write_buffer_pointer, fragment, (enum libwebsocket_write_protocol)write_protocol);
+
+			memcpy(write_buffer_pointer + fragment, post_padding, LWS_SEND_BUFFER_POST_PADDING);
 
-			if (m < user_context->buffer_size) {
-				// incomplete transfer
+			if (m < (int)fragment) {
+				// incomplete transfer: the channel is unusable
 #ifndef NDEBUG
-				lwsl_err("ACCL: LWS_CALLBACK_CLIENT_WRITEABLE (%d bytes transmitted instead of %d bytes)\n", m, user_context->buffer_size);
+				lwsl_err("ACCL: LWS_CALLBACK_CLIENT_WRITEABLE (%d bytes transmitted instead of %d bytes)\n", m, (int)fragment);
 #endif
-			} else {
-				user_context->send_in_progress = 0;
+				return -1;
+			}
+
+			user_context->send_offset += fragment;
+
+			if (user_context->send_offset == user_context->writing->size) {
+				// coalesced messages left the queue accounting already
+				if (&user_context->batch != user_context->sending)
+					acclWebSocketMessageFree(user_context, user_context->sending);
+
+				user_context->sending = NULL;
+				user_context->writing = NULL;
+				user_context->send_offset = 0;
 			}
 
+			// one write per callback: ask for the next one while anything is left
+			if (NULL != user_context->sending || NULL != user_context->next_message || !acclWebSocketQueueEmpty(user_context))
+				libwebsocket_callback_on_writable(this, wsi);
+
 			break;
 		case LWS_CALLBACK_CLIENT_RECEIVE:
 #ifndef NDEBUG
@@ -756,37 +5805,48 @@ int callback_accl_communication(
 			/* data received from server */
 
 			// data can be:
-			// - server initiated communication payload (wait_for_response=0)
-			// - server response to client initiated exchange (wait_for_response=1)
+			// - server initiated communication payload
+			// - server response to a pending client initiated exchange
 
 			if (NULL != user_context) {
-				if (user_context->wait_for_response) {
-#ifndef NDEBUG
-					lwsl_notice("RECEIVED EXCHANGE RESPONSE FROM SERVER\n");
-#endif
-					if (len <= user_context->response_buffer_size) {
-						memcpy(user_context->response_buffer_ptr, in, len);
+				complete = libwebsocket_is_final_fragment(wsi) && 0 == libwebsockets_remaining_packet_payload(wsi);
+
+				if (complete && 0 == user_context->receive_size)
+					// the whole message in one piece, no copy needed
+					return acclWebSocketDeliver(user_context, in, len);
+
+				// fragments are reassembled in a buffer kept for the channel lifetime
+				if (user_context->receive_size + len > user_context->receive_capacity) {
+					capacity = MAX(user_context->receive_capacity * 2, user_context->receive_size + len);
+					grown = (unsigned char*)realloc(user_context->receive_buffer, capacity);
 
-						// reset the wait for response flag (this unlocks waiting threads on acclWebSocketsExchange)
-						user_context->wait_for_response = 0;
-					} else {
+					if (NULL == grown) {
 #ifndef NDEBUG
-						lwsl_err("Exchange response buffer (%d bytes) too small: received (%d bytes)\n", user_context->response_buffer_size, len);
+						lwsl_err("ACCL: unable to reassemble a %d bytes message\n", (int)(user_context->receive_size + len));
 #endif
 						return -1;
 					}
-				} else {
-#ifndef NDEBUG
-					lwsl_notice("ACCL - Data received from server, invoking the callback\n");
-#endif
-					user_context->callback(in, len);
+
+					user_context->receive_buffer = grown;
+					user_context->receive_capacity = capacity;
+				}
+
+				memcpy(user_context->receive_buffer + user_context->receive_size, in, len);
+				user_context->receive_size += len;
+
+				if (complete) {
+					len = user_context->receive_size;
+					user_context->receive_size = 0;
+
+					return acclWebSocketDeliver(user_context, user_context->receive_buffer, len);
 				}
 			}
 			
 			break;
 		case LWS_CALLBACK_CLIENT_CONFIRM_EXTENSION_SUPPORTED:
-
-			break;
+			// the libwebsockets deflate window is fixed at its build time:
+			// channels negotiate their own (ACCL_WS_DEFLATE_OFFER) instead
+			return 1;
 		default:
 			break;
 	}
@@ -802,236 +5862,566 @@ void acclGetWebSocketUri(char *uri, int technique_id, char *application_id) {
 }
 
 int acclGetWebSocketPort(int technique_id) {
-	int port;
+	accl_technique technique;
 
-	switch (technique_id) {
-		case ACCL_TID_CODE_SPLITTING:
-			port = 8082;
-			break;
-		case ACCL_TID_RA_REACTION_MANAGER:
-			port = 8083;
-			break;
-		case ACCL_TID_RA_VERIFIER:
-			port = 8084;
-			break;
-		case ACCL_RA_ATTESTATOR_0:
-		case ACCL_RA_ATTESTATOR_1:
-		case ACCL_RA_ATTESTATOR_2:
-		case ACCL_RA_ATTESTATOR_3:
-		case ACCL_RA_ATTESTATOR_4:
-		case ACCL_RA_ATTESTATOR_5:
-		case ACCL_RA_ATTESTATOR_6:
-		case ACCL_RA_ATTESTATOR_7:
-		case ACCL_RA_ATTESTATOR_8:
-		case ACCL_RA_ATTESTATOR_9:
-			port = technique_id - 9000 + 8090;
-			break;
-		case ACCL_RENEWABILITY:
-			port = 18001;
-			break;
-		default:
-			port = ACCL_WS_ASPIRE_PORTAL_PORT;
-			break;
-	}
+	if (!acclRegistryLookup(technique_id, &technique))
+		return ACCL_WS_ASPIRE_PORTAL_PORT;
 
-	return port;
+	return technique.ws_port;
 }
 
 /*
-	ACCL WebSockets initialization
+	Channel of a handle: acclWebSocketInit hands out the channels
+	themselves, connections of the client context
 */
-struct libwebsocket_context* acclWebSocketInit (const int T_ID, void* (* callback)(void*, size_t)) {
-	int use_ssl=0, ietf_version=-1, port;
+static struct accl_context_buffer* acclWebSocketChannel(struct libwebsocket_context* context) {
+	return (struct accl_context_buffer*)context;
+}
 
-	struct lws_context_creation_info info;
-	struct libwebsocket_context *context;
-	struct libwebsocket *wsi_accl;
+/*
+	Connects a channel to its WebSockets host, reconnections fail over to
+	the best host available; service thread
+*/
+static void acclWebSocketOpen(accl_client* client, struct accl_context_buffer* user_context) {
+	int use_ssl=0, ietf_version=-1;
+	const char* host;
+	struct libwebsocket* wsi_accl = NULL;
+	char aspire_portal_uri[1024];
+	int closing;
+	int n;
+
+	if (user_context->opened && (n = acclPortalPick(&client->ws_portals, 0)) >= 0)
+		user_context->node = n;
+
+	host = client->ws_portals.nodes[user_context->node].endpoint;
+
+	acclGetWebSocketUri(aspire_portal_uri, user_context->technique_id, client->application_id);
+
+	pthread_mutex_lock(&user_context->mutex);
+	closing = user_context->closing;
+	pthread_mutex_unlock(&user_context->mutex);
+
+	// establish connection to server, the channel is the connection user data
+	if (!closing)
+		wsi_accl = libwebsocket_client_connect_extended(
+			client->ws_service.context,
+			host,
+			acclGetWebSocketPort(user_context->technique_id),
+			use_ssl,
+			aspire_portal_uri,
+			host,
+			host,
+			protocols[PROTOCOL_ACCL_COMMUNICATION].name,
+			ietf_version,
+			user_context
+		);
+
+#ifndef NDEBUG
+	lwsl_notice("ACCL - acclWebSocketOpen() - client_connected to host: %s, uri: %s\n", host, aspire_portal_uri);
+#endif
+
+	if (NULL == wsi_accl) {
+#ifndef NDEBUG
+		lwsl_err("ACCL - libwebsocket connection to ASPIRE Portal %s failed\n", aspire_portal_uri);
+#endif
+		acclWebSocketClosed(user_context);
+		return;
+	}
+
+	user_context->wsi = wsi_accl;
+}
+
+/*
+	Service thread: connects channels and runs every libwebsockets
+	callback of the client context, application threads wake it up
+	with libwebsocket_cancel_service
+*/
+static void* acclWebSocketService(void* arg) {
+	accl_client* client = (accl_client*)arg;
+	accl_ws_service* service = &client->ws_service;
+	struct accl_context_buffer* connects[ACCL_MAX_WS_THREADS];
 	struct accl_context_buffer* user_context;
-	struct libwebsocket_protocols *context_protocols;
+	unsigned int i, connect_count;
+	unsigned long long now;
+	int timeout;
+	int closing;
+
+	for (;;) {
+		pthread_mutex_lock(&service->mutex);
+		if (service->stopping) {
+			pthread_mutex_unlock(&service->mutex);
+			break;
+		}
 
-	int connect_max_tries = 100;
+		connect_count = 0;
+		timeout = ACCL_WS_SERVICE_TIMEOUT;
+		now = acclNow();
 
-	char aspire_portal_uri[1024];
+		for (i = 0; i < ACCL_MAX_WS_THREADS; i++) {
+			user_context = service->channels[i];
 
-	acclGetWebSocketUri(aspire_portal_uri, T_ID, GetAspireApplicationId());
-	port = acclGetWebSocketPort(T_ID);
+			if (NULL == user_context)
+				continue;
 
-	memset(&info, 0, sizeof info);
+			if (user_context->connect_requested) {
+				user_context->connect_requested = 0;
+				connects[connect_count++] = user_context;
+			} else if (0 != user_context->reconnect_at) {
+				pthread_mutex_lock(&user_context->mutex);
+				closing = user_context->closing;
+				pthread_mutex_unlock(&user_context->mutex);
 
-	// user context information
-	user_context = (struct accl_context_buffer*)malloc(sizeof(struct accl_context_buffer));
-	user_context->buffer_ptr = malloc(ACCL_MAX_WS_BUFFER_SIZE);
-	user_context->technique_id = T_ID;
-	user_context->buffer_size = 0;
-	user_context->callback = callback;
-	user_context->initialization_complete = 0;
-	user_context->send_in_progress = 0;
-	user_context->wait_for_response = 0;
+				// dropped: reconnected after its backoff, closed for good once shut down
+				if (closing || user_context->reconnect_at <= now) {
+					user_context->reconnect_at = 0;
+					connects[connect_count++] = user_context;
+				} else {
+					timeout = MIN(timeout, (int)((user_context->reconnect_at - now) / 1000) + 1);
+				}
+			} else if (__atomic_exchange_n(&user_context->write_requested, 0, __ATOMIC_ACQ_REL) && NULL != user_context->wsi) {
+				libwebsocket_callback_on_writable(service->context, user_context->wsi);
+			}
+		}
 
-	if (NULL == user_context->buffer_ptr)
-		return NULL;
+		pthread_mutex_unlock(&service->mutex);
+
+		// connecting channels are only freed once closed, by this thread
+		for (i = 0; i < connect_count; i++)
+			acclWebSocketOpen(client, connects[i]);
+
+		libwebsocket_service(service->context, timeout);
+	}
+
+	return NULL;
+}
+
+/*
+	Creates the client context and its service thread with the first
+	channel
+*/
+static int acclWebSocketServiceStart(accl_client* client) {
+	accl_ws_service* service = &client->ws_service;
+	struct lws_context_creation_info info;
+	int returnValue = ACCL_SUCCESS;
 
-	/**
-	 * since libwebsockets is not nativevely thread safe we need to make sure that each connection use its own
-	 * protocols array
-	 *
-	 * https://github.com/warmcat/libwebsockets/issues/145
-	 * https://github.com/warmcat/libwebsockets/issues/566
-	 */
-	context_protocols = (struct libwebsocket_protocols*)malloc(sizeof(struct libwebsocket_protocols) * 2);
-	memcpy(context_protocols, protocols, sizeof(struct libwebsocket_protocols) * 2);
+	pthread_mutex_lock(&service->mutex);
 
-	user_context->protocols = context_protocols;
+	if (NULL == service->context) {
+		memset(&info, 0, sizeof info);
 
-	info.iface = NULL;
-	info.ssl_cert_filepath = NULL;
-	info.ssl_private_key_filepath = NULL;
-	info.port = CONTEXT_PORT_NO_LISTEN;
-	info.protocols = context_protocols;
-	info.gid = -1;
-	info.uid = -1;
-	info.options = 0;
-	info.user = (void*)user_context;
+		/**
+		 * libwebsockets binds the protocols array to its context
+		 *
+		 * https://github.com/warmcat/libwebsockets/issues/145
+		 * https://github.com/warmcat/libwebsockets/issues/566
+		 */
+		memcpy(service->protocols, protocols, sizeof(service->protocols));
 
-	context = libwebsocket_create_context(&info);
+		info.iface = NULL;
+		info.ssl_cert_filepath = NULL;
+		info.ssl_private_key_filepath = NULL;
+		info.port = CONTEXT_PORT_NO_LISTEN;
+		info.protocols = service->protocols;
+		info.gid = -1;
+		info.uid = -1;
+		info.options = 0;
+		info.user = (void*)client;
+
+		service->context = libwebsocket_create_context(&info);
 
 #ifndef NDEBUG
-	lwsl_notice("ACCL - acclWebSocketInit() - context created\n");
+		lwsl_notice("ACCL - acclWebSocketServiceStart() - context created\n");
 #endif
 
-	if (NULL == context) {
+		if (NULL == service->context) {
 #ifndef NDEBUG
-		lwsl_err("Creating libwebsocket context failed\n");
+			lwsl_err("Creating libwebsocket context failed\n");
 #endif
-		return NULL;
+			returnValue = ACCL_GENERIC_ERROR;
+		} else if (0 != pthread_create(&service->thread, NULL, acclWebSocketService, client)) {
+			libwebsocket_context_destroy(service->context);
+			service->context = NULL;
+			returnValue = ACCL_GENERIC_ERROR;
+		}
 	}
 
-	char host[1024];
-	FILE * hostfile = fopen(ACCL_FILE_PATH "/ASPIREhost","r");
-	if (!hostfile)
-	{
-	      strncpy(host,ACCL_WS_ASPIRE_PORTAL_HOST,1024);
+	pthread_mutex_unlock(&service->mutex);
+
+	return returnValue;
+}
+
+/*
+	Stops the service thread and closes the client context; channels
+	still open are freed with it
+*/
+static void acclWebSocketServiceDestroy(accl_client* client) {
+	accl_ws_service* service = &client->ws_service;
+	unsigned int i;
+
+	if (NULL != service->context) {
+		pthread_mutex_lock(&service->mutex);
+		service->stopping = 1;
+		pthread_mutex_unlock(&service->mutex);
+
+		libwebsocket_cancel_service(service->context);
+		pthread_join(service->thread, NULL);
+
+		// libwebsockets belongs to this thread now, orphaned channels go with their connections
+		libwebsocket_context_destroy(service->context);
+
+		pthread_mutex_lock(&service->mutex);
+		for (i = 0; i < ACCL_MAX_WS_THREADS; i++)
+			if (NULL != service->channels[i])
+				acclWebSocketChannelFree(service->channels[i]);
+		pthread_mutex_unlock(&service->mutex);
 	}
-	else
-	{
-	      fscanf(hostfile,"%s",host);
-	      fclose(hostfile);
+
+	pthread_mutex_destroy(&service->mutex);
+}
+
+/*
+	Waits for the channel to reach a state (1 open, 2 closed), 0 on
+	timeout; user_context->mutex held
+*/
+static int acclWebSocketWaitState(struct accl_context_buffer* user_context, const int state) {
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += ACCL_WS_CONNECT_TIMEOUT / 1000;
+	deadline.tv_nsec += (long)(ACCL_WS_CONNECT_TIMEOUT % 1000) * 1000000L;
+
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
 	}
 
-	// establish connection to server
-	wsi_accl = libwebsocket_client_connect(
-		context,
-		host,
-		port,
-		use_ssl,
-		aspire_portal_uri,
-		host,
-		host,
-		protocols[PROTOCOL_ACCL_COMMUNICATION].name,
-		ietf_version
-	);
+	while (user_context->initialization_complete < state &&
+			ETIMEDOUT != pthread_cond_timedwait(&user_context->done, &user_context->mutex, &deadline))
+		;
 
-#ifndef NDEBUG
-	lwsl_notice("ACCL - acclWebSocketInit() - client_connected to host: %s, uri: %s, port: %d\n", host, aspire_portal_uri, port);
-#endif
+	return (user_context->initialization_complete >= state);
+}
+
+/*
+	ACCL WebSockets initialization
+*/
+/*
+	Opens the channel of a technique to WebSockets host n
+*/
+static struct libwebsocket_context* acclWebSocketConnect (accl_client* client, const int T_ID, void* (* callback)(void*, size_t), const int n) {
+	accl_ws_service* service = &client->ws_service;
+	struct accl_context_buffer* user_context;
+	accl_retry_policy policy;
+	accl_technique technique;
+	int slot;
+	int opened;
+
+	if (ACCL_SUCCESS != acclWebSocketServiceStart(client))
+		return NULL;
+
+	// user context information
+	user_context = (struct accl_context_buffer*)calloc(1, sizeof(struct accl_context_buffer));
 
-	if (wsi_accl == NULL) {
+	if (NULL == user_context)
+		return NULL;
+
+	user_context->send_buffer = NULL;
+	user_context->technique_id = T_ID;
+	user_context->client = client;
+	user_context->portal = -1;
+	user_context->callback = callback;
+	user_context->initialization_complete = 0;
+	user_context->service = service;
+	user_context->node = n;
+	user_context->queue_budget = ACCL_WS_QUEUE_BUDGET;
+	user_context->backpressure = ACCL_WS_BACKPRESSURE_BLOCK;
+	user_context->references = 1;
+
+	user_context->reconnect_backoff = ACCL_WS_RECONNECT_BACKOFF;
+	user_context->reconnect_max_backoff = ACCL_WS_RECONNECT_MAX_BACKOFF;
+
+	if (acclRegistryLookup(T_ID, &technique)) {
+		user_context->queue_budget = technique.ws_queue_budget;
+		user_context->backpressure = technique.ws_backpressure;
+
+		// reconnections follow the technique retry policy
+		if (acclRetryLookup(&client->retry, client->stats, &technique, &policy)) {
+			if (policy.backoff > 0) {
+				user_context->reconnect_backoff = policy.backoff;
+				user_context->reconnect_max_backoff = MAX(policy.max_backoff, policy.backoff);
+			}
+
+			user_context->reissue = (0 != (policy.flags & ACCL_RETRY_IDEMPOTENT));
+		}
+
+		// offered on every connection, plain messages when the portal declines
+		if (ACCL_WS_DEFLATE && technique.ws_deflate) {
+			user_context->deflate = (struct accl_ws_deflate*)calloc(1, sizeof(struct accl_ws_deflate));
+
+			if (NULL != user_context->deflate) {
+				user_context->deflate->window_bits = (int)technique.ws_deflate_window_bits;
+				user_context->deflate->mem_level = (int)technique.ws_deflate_mem_level;
+			}
+		}
+	}
+
+	acclWebSocketQueueInit(user_context);
+
+	pthread_mutex_init(&user_context->mutex, NULL);
+	pthread_cond_init(&user_context->done, NULL);
+
+	// the service thread connects the channels of its table
+	pthread_mutex_lock(&service->mutex);
+
+	for (slot = 0; slot < ACCL_MAX_WS_THREADS && NULL != service->channels[slot]; slot++)
+		;
+
+	if (slot < ACCL_MAX_WS_THREADS) {
+		user_context->slot = slot;
+		user_context->connect_requested = 1;
+		service->channels[slot] = user_context;
+		service->channel_count++;
+	}
+
+	pthread_mutex_unlock(&service->mutex);
+
+	if (slot == ACCL_MAX_WS_THREADS) {
 #ifndef NDEBUG
-		lwsl_err("ACCL - libwebsocket connection to ASPIRE Portal %s failed\n", aspire_portal_uri);
+		lwsl_err("ACCL - acclWebSocketConnect() - %d channels open already\n", ACCL_MAX_WS_THREADS);
 #endif
+		pthread_cond_destroy(&user_context->done);
+		pthread_mutex_destroy(&user_context->mutex);
+		free(user_context->deflate);
+		free(user_context);
 		return NULL;
-	} else {
-		// wait for channel initialization
-		while (0 == user_context->initialization_complete && connect_max_tries > 0) {
-			libwebsocket_service(context, 50);
+	}
 
-			connect_max_tries -= 1;
-		}
+	libwebsocket_cancel_service(service->context);
+
+	// wait for channel initialization
+	pthread_mutex_lock(&user_context->mutex);
+	opened = acclWebSocketWaitState(user_context, 1) && 1 == user_context->initialization_complete;
+	pthread_mutex_unlock(&user_context->mutex);
 
 #ifndef NDEBUG
-		lwsl_err("ACCL - acclWebSocketInit() - initialization complete\n");
+	lwsl_err("ACCL - acclWebSocketInit() - initialization complete\n");
 #endif
 
-		if (user_context->initialization_complete == 2) {
-			acclWebSocketShutdown(context);
+	if (!opened) {
+		acclWebSocketShutdown((struct libwebsocket_context*)user_context);
 #ifndef NDEBUG
-			lwsl_err("ACCL - WebSockets CLIENT CONNECTION ERROR\n");
+		lwsl_err("ACCL - WebSockets CLIENT CONNECTION ERROR\n");
 #endif
-			return NULL;
-		}
+		return NULL;
+	}
 #ifndef NDEBUG
-		lwsl_notice("ACCL - libwebsocket connection to ASPIRE Portal %s succeeded.\n", aspire_portal_uri);
+	lwsl_notice("ACCL - libwebsocket connection to ASPIRE Portal (TID: %d) succeeded.\n", T_ID);
 #endif
+	return (struct libwebsocket_context*)user_context;
+}
+
+struct libwebsocket_context* acclClientWebSocketInit (accl_client* client, const int T_ID, void* (* callback)(void*, size_t)) {
+	struct libwebsocket_context* context = NULL;
+	unsigned int tried = 0;
+	unsigned int channel_count;
+	int n;
+
+	if (NULL == client)
+		return NULL;
+
+	// channel opened by acclWarmup
+	context = acclWarmupClaim(client, T_ID);
+
+	if (NULL != context) {
+		// the service thread may be delivering server messages already
+		__atomic_store_n(&acclWebSocketChannel(context)->callback, callback, __ATOMIC_RELEASE);
 		return context;
 	}
+
+	pthread_mutex_lock(&client->ws_service.mutex);
+	channel_count = client->ws_service.channel_count;
+	pthread_mutex_unlock(&client->ws_service.mutex);
+
+	// no host to blame for a full channel table
+	if (channel_count >= ACCL_MAX_WS_THREADS)
+		return NULL;
+
+	// a host that cannot be reached is failed over to the next one
+	while (NULL == context && (n = acclPortalPick(&client->ws_portals, tried)) >= 0) {
+		tried |= 1u << n;
+
+		context = acclWebSocketConnect(client, T_ID, callback, n);
+
+		if (NULL == context)
+			acclPortalDown(&client->ws_portals, n);
+	}
+
+	return context;
+}
+
+struct libwebsocket_context* acclWebSocketInit (const int T_ID, void* (* callback)(void*, size_t)) {
+	return acclClientWebSocketInit(acclDefaultClient(), T_ID, callback);
 }
 
 /**
  * Terminates the channel associated to the specified context
  */
 int acclWebSocketShutdown (struct libwebsocket_context* context) {
+	struct accl_context_buffer* user_context;
+	accl_ws_service* service;
+	int closed;
 
-	if (NULL != context) {
-		struct accl_context_buffer* user_context = (struct accl_context_buffer*)libwebsocket_context_user(context);
+	if (NULL == context)
+		return ACCL_WS_INVALID_CONTEXT;
 
-		if (NULL != user_context)
-			free(user_context);
+	user_context = acclWebSocketChannel(context);
+	service = user_context->service;
 
-		libwebsocket_cancel_service(context);
-		libwebsocket_context_destroy(context);
+	pthread_mutex_lock(&user_context->mutex);
+	user_context->closing = 1;
+	closed = (2 == user_context->initialization_complete);
+	pthread_mutex_unlock(&user_context->mutex);
 
-		return ACCL_SUCCESS;
+	if (!closed) {
+		// only the service thread may close the connection
+		__atomic_store_n(&user_context->write_requested, 1, __ATOMIC_RELEASE);
+		libwebsocket_cancel_service(service->context);
+
+		pthread_mutex_lock(&user_context->mutex);
+		closed = acclWebSocketWaitState(user_context, 2);
+
+		// still connecting: freed by the service thread when it gives up
+		if (!closed)
+			user_context->orphaned = 1;
+
+		pthread_mutex_unlock(&user_context->mutex);
 	}
 
-	return ACCL_WS_INVALID_CONTEXT;
+	// freed once the calls in flight, woken above, are gone
+	if (closed)
+		acclWebSocketChannelPut(user_context);
+
+	return ACCL_SUCCESS;
 }
 
-/**
- * Internal communication helper
- */
-int _acclWebSocketCommunication (int wait_for_response, struct libwebsocket_context* context, const unsigned int payloadBufferSize, const char* pPayloadBuffer, unsigned int returnBufferSize, char* pReturnBuffer) {
-	char* out_buffer = (char*)malloc(sizeof(char) * (payloadBufferSize + 1));
+/*
+	Queues a message and, for exchanges, waits for the response; the
+	caller holds a reference to the channel
+*/
+static int acclWebSocketCommunicate (int wait_for_response, struct accl_context_buffer* user_context, const unsigned int payloadBufferSize, const char* pPayloadBuffer, unsigned int returnBufferSize, char* pReturnBuffer) {
+	struct accl_ws_exchange exchange;
+	struct accl_ws_message* message;
+	unsigned int header = (wait_for_response && ACCL_WS_MULTIPLEX) ? ACCL_WS_TAG_SIZE : 1;
+	int type = !wait_for_response ? ACCL_WS_SEND : (ACCL_WS_MULTIPLEX ? ACCL_WS_TAGGED_EXCHANGE : ACCL_WS_EXCHANGE);
+	unsigned long long started = acclNow();
+	size_t received = 0;
+	int returnValue;
+
+	// reconnecting channels keep queueing
+	if (2 == __atomic_load_n(&user_context->initialization_complete, __ATOMIC_ACQUIRE))
+		return ACCL_WS_ALREADY_SHUT_DOWN;
+
+	// over the queue budget: wait for the service thread, or give up
+	returnValue = acclWebSocketQueueReserve(user_context, payloadBufferSize + header);
+
+	if (ACCL_SUCCESS != returnValue)
+		return returnValue;
+
+	// the message is built once, in place, behind the padding libwebsockets needs
+	message = acclWebSocketMessageCreate(type, header, pPayloadBuffer, payloadBufferSize);
+
+	if (NULL == message) {
+		acclWebSocketQueueRelease(user_context, payloadBufferSize + header);
+		return ACCL_GENERIC_ERROR;
+	}
 
-	if (NULL == context)
-		return ACCL_WS_INVALID_CONTEXT;
+	if (wait_for_response) {
+		pthread_mutex_lock(&user_context->mutex);
+
+		// untagged exchanges cannot overlap
+		while (2 != user_context->initialization_complete && !ACCL_WS_MULTIPLEX && user_context->pending_count > 0)
+			pthread_cond_wait(&user_context->done, &user_context->mutex);
+
+		if (2 == user_context->initialization_complete) {
+			pthread_mutex_unlock(&user_context->mutex);
+			acclWebSocketMessageFree(user_context, message);
 
-	// prepare user context for sending callback
-	struct accl_context_buffer* user_context = (struct accl_context_buffer*)libwebsocket_context_user(context);
+			return ACCL_WS_ALREADY_SHUT_DOWN;
+		}
+
+		exchange.id = ACCL_WS_MULTIPLEX ? user_context->next_id++ : 0;
+		exchange.buffer = pReturnBuffer;
+		exchange.capacity = returnBufferSize;
+		exchange.size = 0;
+		exchange.status = ACCL_WS_PENDING;
+		exchange.payload = pPayloadBuffer;
+		exchange.payload_size = payloadBufferSize;
+		exchange.written = 0;
+		pthread_cond_init(&exchange.done, NULL);
 
-	if (NULL != user_context) {
-		// the first byte is used to identify the type of call (0=send / 1=exchange)
-		out_buffer[0] = wait_for_response;
+		if (ACCL_WS_MULTIPLEX)
+			acclWebSocketTag(message, exchange.id);
 
-		// let's copy the payload to the output buffer
-		memcpy(out_buffer + 1, pPayloadBuffer, payloadBufferSize);
+		// registered before the message leaves: the response may be quick
+		acclWebSocketPendingAdd(user_context, &exchange);
+
+		pthread_mutex_unlock(&user_context->mutex);
+	}
 
-		user_context->buffer_ptr = (void*)out_buffer;
-		user_context->buffer_size = payloadBufferSize + 1;
-		user_context->wait_for_response = wait_for_response;
-		user_context->response_buffer_ptr = pReturnBuffer;
-		user_context->response_buffer_size = returnBufferSize;
-		user_context->send_in_progress = 1;
+	acclWebSocketQueuePush(user_context, message);
 
 #ifndef NDEBUG
-		lwsl_notice("request write on channel\n");
+	lwsl_notice("request write on channel\n");
 #endif
-		/* request a write callback to libwebsocket */
-		libwebsocket_callback_on_writable_all_protocol(user_context->protocols);
+	/* the service thread asks libwebsocket for a write callback, one wake-up for a burst of messages */
+	if (!__atomic_exchange_n(&user_context->write_requested, 1, __ATOMIC_ACQ_REL))
+		libwebsocket_cancel_service(user_context->service->context);
 
-		while (1 == user_context->send_in_progress) {
-			libwebsocket_service(context, 50);
-		}
+	if (wait_for_response) {
+		pthread_mutex_lock(&user_context->mutex);
+
+		// responses may come back in any order
+		while (ACCL_WS_PENDING == exchange.status)
+			pthread_cond_wait(&exchange.done, &user_context->mutex);
+
+		returnValue = exchange.status;
+		received = exchange.size;
+
+		pthread_mutex_unlock(&user_context->mutex);
+
+		pthread_cond_destroy(&exchange.done);
+	}
 
-		while (1 == user_context->wait_for_response) {
-			libwebsocket_service(context, 50);
-		}
 #ifndef NDEBUG
-		lwsl_notice("send terminated\n");
+	lwsl_notice("send terminated\n");
 #endif
-		return ACCL_SUCCESS;
-	}
+	acclStatsRecord(user_context->client->stats, user_context->technique_id, returnValue, started, payloadBufferSize,
+		(ACCL_SUCCESS == returnValue) ? received : 0);
+
+	return returnValue;
+}
+
+/**
+ * Internal communication helper
+ */
+int _acclWebSocketCommunication (int wait_for_response, struct libwebsocket_context* context, const unsigned int payloadBufferSize, const char* pPayloadBuffer, unsigned int returnBufferSize, char* pReturnBuffer) {
+	struct accl_context_buffer* user_context;
+	int returnValue;
+
+	if (NULL == context)
+		return ACCL_WS_INVALID_CONTEXT;
+
+	user_context = acclWebSocketChannel(context);
+
+	// a concurrent acclWebSocketShutdown frees the channel once this call is gone
+	__atomic_add_fetch(&user_context->references, 1, __ATOMIC_ACQ_REL);
+
+	returnValue = acclWebSocketCommunicate(wait_for_response, user_context, payloadBufferSize, pPayloadBuffer,
+		returnBufferSize, pReturnBuffer);
+
+	acclWebSocketChannelPut(user_context);
 
-	return ACCL_GENERIC_ERROR;
+	return returnValue;
 }
 
 /**
@@ -50,17 +50,943 @@ ACCL_EXTERN int acclExchange (
 	char** 	pReturnBuffer
 );
 
+/*******************************************************************
+* NAME :            acclExchangeInto
+*
+* DESCRIPTION :     Same as acclExchange, the response is written straight
+*		    into a buffer supplied by the caller
+*
+* INPUTS :
+*       PARAMETERS:
+*			const int	T_ID					[in] technique unique identifier
+*			const int   payloadBufferSize		[in] payload buff. size in bytes
+*			const char* pPayloadBuffer			[in] payload buffer
+*			const unsigned int returnBufferCapacity [in] return buff. capacity
+*       GLOBALS :
+*	    None
+* OUTPUTS :
+*       PARAMETERS:
+*           char* pReturnBuffer              [out] return buffer
+*           unsigned int* returnBufferSize   [out] return buff. size in bytes
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   	int                 Error code:
+*            Values: 	ACCL_SUCCESS        0
+*						ACCL_OUTPUT_BUFFER_MAX_SIZE_EXCEEDED response larger than
+*											returnBufferCapacity
+*		     			ACCL_ERROR		    Anything else
+*/
+ACCL_EXTERN int acclExchangeInto (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int returnBufferCapacity,
+	char* pReturnBuffer,
+	unsigned int* returnBufferSize
+);
+
+/* payload segment of the scatter-gather primitives */
+typedef struct accl_iovec {
+	const void* base;					/* segment start */
+	unsigned int length;				/* segment size in bytes */
+} accl_iovec;
+
+/*******************************************************************
+* NAME :            acclExchangeV
+*
+* DESCRIPTION :     Same as acclExchange, the payload is gathered from
+*		    several segments without concatenating them first
+*
+* INPUTS :
+*       PARAMETERS:
+*			const int	T_ID					[in] technique unique identifier
+*			const accl_iovec* segments			[in] payload segments
+*			const unsigned int segmentCount		[in] number of segments
+*       GLOBALS :
+*	    None
+* OUTPUTS :
+*       PARAMETERS:
+*           unsigned int* returnBufferSize   [out] return buff. size in bytes
+*           char** pReturnBuffer             [out] return buffer
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   	int                 Error code:
+*            Values: 	ACCL_SUCCESS        0
+*		     			ACCL_ERROR		    Anything else
+*/
+ACCL_EXTERN int acclExchangeV (
+	const int T_ID,
+	const accl_iovec* segments,
+	const unsigned int segmentCount,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer
+);
+
+/* response chunk consumer, returns 0 to continue the transfer */
+typedef int (* accl_stream_callback)(
+	const char* chunk,
+	unsigned int chunkSize,
+	void* user_data
+);
+
+/*******************************************************************
+* NAME :            acclExchangeStream
+*
+* DESCRIPTION :     Same as acclExchange, the response is delivered chunk
+*		    by chunk while it is still being received
+*
+* INPUTS :
+*       PARAMETERS:
+*			const int	T_ID					[in] technique unique identifier
+*			const int   payloadBufferSize		[in] payload buff. size in bytes
+*			const char* pPayloadBuffer			[in] payload buffer
+*			accl_stream_callback callback		[in] chunk consumer
+*			void*		user_data				[in] passed back to the callback
+*       GLOBALS :
+*	    None
+* OUTPUTS :
+*       PARAMETERS:
+*           None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   	int                 Error code:
+*            Values: 	ACCL_SUCCESS        0
+*						ACCL_STREAM_ABORTED callback requested to stop
+*		     			ACCL_ERROR		    Anything else
+* PROCESS :
+*	[1]  Send payload to the ASPIRE aspire-portal
+*	[2]  Invoke callback on each response chunk (chunks are only valid
+*	     during the call); the response size is not limited
+*/
+ACCL_EXTERN int acclExchangeStream (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	accl_stream_callback callback,
+	void* user_data
+);
+
+/* payload producer, fills at most bufferSize bytes of buffer and returns
+   the number of bytes produced, 0 once the payload is complete or a
+   negative value to abort the request */
+typedef int (* accl_producer_callback)(
+	char* buffer,
+	unsigned int bufferSize,
+	void* user_data
+);
+
+/*******************************************************************
+* NAME :            acclExchangeChunked
+*
+* DESCRIPTION :     Same as acclExchange, the payload is generated by a
+*		    producer callback while it is being uploaded
+*
+* INPUTS :
+*       PARAMETERS:
+*			const int	T_ID					[in] technique unique identifier
+*			accl_producer_callback producer		[in] payload producer
+*			void*		user_data				[in] passed back to the producer
+*       GLOBALS :
+*	    None
+* OUTPUTS :
+*       PARAMETERS:
+*           unsigned int* returnBufferSize   [out] return buff. size in bytes
+*           char** pReturnBuffer             [out] return buffer
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   	int                 Error code:
+*            Values: 	ACCL_SUCCESS        0
+*						ACCL_PRODUCER_ABORTED producer failed
+*		     			ACCL_ERROR		    Anything else
+* PROCESS :
+*	[1]  Upload the payload with chunked transfer encoding, one
+*	     ACCL_UPLOAD_CHUNK_SIZE block at a time (no payload size limit)
+*	[2]  Fill the return buffer with response data
+*/
+ACCL_EXTERN int acclExchangeChunked (
+	const int T_ID,
+	accl_producer_callback producer,
+	void* user_data,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer
+);
+
 /*******************************************************************
 * NAME :            acclSend
 *
-* DESCRIPTION :     Send a request to the ASPIRE aspire-portal without
-*		    expecting a return value
+* DESCRIPTION :     Send a request to the ASPIRE aspire-portal without
+*		    expecting a return value
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   T_ID                    technique unique identifier
+*           const int   payloadBufferSize       payload buffer size in bytes
+*           const char* pPayloadBuffer          payload buffer
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_ERROR              Anything else
+* PROCESS :
+*                   [1]  Send payload to the ASPIRE aspire-portal
+*/
+ACCL_EXTERN int acclSend (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer
+);
+
+/*******************************************************************
+* NAME :            acclSendV
+*
+* DESCRIPTION :     Same as acclSend, the payload is gathered from
+*		    several segments without concatenating them first
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   T_ID                    technique unique identifier
+*           const accl_iovec* segments          payload segments
+*           const unsigned int segmentCount     number of segments
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_ERROR              Anything else
+*/
+ACCL_EXTERN int acclSendV (
+	const int T_ID,
+	const accl_iovec* segments,
+	const unsigned int segmentCount
+);
+
+/*******************************************************************
+* NAME :            acclSendChunked
+*
+* DESCRIPTION :     Same as acclSend, the payload is generated by a
+*		    producer callback while it is being uploaded
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   T_ID                    technique unique identifier
+*           accl_producer_callback producer     payload producer
+*           void*       user_data               passed back to the producer
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_PRODUCER_ABORTED   producer failed
+*                    ACCL_ERROR              Anything else
+*/
+ACCL_EXTERN int acclSendChunked (
+	const int T_ID,
+	accl_producer_callback producer,
+	void* user_data
+);
+
+/*******************************************************************
+* NAME :            acclExchangeDeadline
+*
+* DESCRIPTION :     Same as acclExchange, the whole request must complete
+*		    within the given time
+*
+* INPUTS :
+*       PARAMETERS:
+*			const int	T_ID					[in] technique unique identifier
+*			const int   payloadBufferSize		[in] payload buff. size in bytes
+*			const char* pPayloadBuffer			[in] payload buffer
+*			const unsigned int timeout			[in] deadline in milliseconds
+*												(0: client timeouts)
+*       GLOBALS :
+*	    None
+* OUTPUTS :
+*       PARAMETERS:
+*           unsigned int* returnBufferSize   [out] return buff. size in bytes
+*           char** pReturnBuffer             [out] return buffer
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   	int                 Error code:
+*            Values: 	ACCL_SUCCESS        0
+*						ACCL_TIMEOUT		deadline expired
+*		     			ACCL_ERROR		    Anything else
+*/
+ACCL_EXTERN int acclExchangeDeadline (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int timeout,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer
+);
+
+/*******************************************************************
+* NAME :            acclSendDeadline
+*
+* DESCRIPTION :     Same as acclSend, the whole request must complete
+*		    within the given time
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   T_ID                    technique unique identifier
+*           const int   payloadBufferSize       payload buffer size in bytes
+*           const char* pPayloadBuffer          payload buffer
+*           const unsigned int timeout          deadline in milliseconds
+*                                               (0: client timeouts)
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_TIMEOUT            deadline expired
+*                    ACCL_ERROR              Anything else
+*/
+ACCL_EXTERN int acclSendDeadline (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int timeout
+);
+
+/*******************************************************************
+* NAME :            acclSetCompression
+*
+* DESCRIPTION :     Enable or disable HTTP payload compression
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   enabled                 0 disables compression
+*           const unsigned int threshold        minimum payload size (bytes)
+*                                               to be compressed
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            None
+* PROCESS :
+*                   [1]  Payloads of at least threshold bytes are sent gzip
+*                        encoded (Content-Encoding) when that makes them
+*                        smaller; the level adapts to the measured upload
+*                        throughput
+*                   [2]  Compressed responses are accepted (Accept-Encoding)
+*                        and decoded transparently
+*/
+ACCL_EXTERN void acclSetCompression (
+	const int enabled,
+	const unsigned int threshold
+);
+
+/*******************************************************************
+* NAME :            acclSetTimeouts
+*
+* DESCRIPTION :     Configure the timeouts of the HTTP requests
+*
+* INPUTS :
+*       PARAMETERS:
+*           const unsigned int connectTimeout   connection setup limit (ms)
+*           const unsigned int totalTimeout     whole request limit (ms),
+*                                               0 for none
+*           const unsigned int lowSpeedLimit    minimum transfer speed
+*                                               (bytes/s), 0 for none
+*           const unsigned int lowSpeedTime     seconds below lowSpeedLimit
+*                                               before a transfer is aborted
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            None
+* PROCESS :
+*                   [1]  Requests exceeding a limit fail with ACCL_TIMEOUT
+*                   [2]  The deadline of acclExchangeDeadline/acclSendDeadline
+*                        replaces totalTimeout and the low speed limit for
+*                        that call
+*
+* NOTES :           defaults are ACCL_CONNECT_TIMEOUT, ACCL_RESPONSE_TIMEOUT,
+*                   ACCL_LOW_SPEED_LIMIT and ACCL_LOW_SPEED_TIME
+*/
+ACCL_EXTERN void acclSetTimeouts (
+	const unsigned int connectTimeout,
+	const unsigned int totalTimeout,
+	const unsigned int lowSpeedLimit,
+	const unsigned int lowSpeedTime
+);
+
+/* portal selection policies (see acclSetBalancing) */
+#define ACCL_BALANCE_LEAST_OUTSTANDING	0	/* fewest requests in flight */
+#define ACCL_BALANCE_EWMA				1	/* lowest latency EWMA, weighted by load */
+
+/*******************************************************************
+* NAME :            acclSetBalancing
+*
+* DESCRIPTION :     Choose how requests are spread over the ASPIRE
+*		    Portal nodes listed in the endpoint configuration
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   policy                  ACCL_BALANCE_* policy
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_GENERIC_ERROR      unknown policy
+* PROCESS :
+*                   [1]  Nodes refusing connections are failed over at once
+*                        and avoided for ACCL_PORTAL_DOWN_TIME ms
+*                   [2]  Every ACCL_PORTAL_HEALTH_INTERVAL ms the nodes are
+*                        probed and marked up or down; WebSockets hosts on
+*                        the port a channel last connected to them on
+*                   [3]  Among the nodes up, the policy picks the one with
+*                        the fewest requests in flight, or the lowest
+*                        latency EWMA times the requests in flight
+*
+* NOTES :           ASPIREendpoint and ASPIREhost (or the acclClientCreate
+*                   arguments) may list up to ACCL_MAX_PORTALS nodes,
+*                   separated by commas or white space
+*/
+ACCL_EXTERN int acclSetBalancing (
+	const int policy
+);
+
+/*******************************************************************
+* NAME :            acclWarmup
+*
+* DESCRIPTION :     Prepare the connections to the ASPIRE Portal ahead
+*		    of the first request
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int*  techniqueIds            techniques whose WebSockets
+*                                               channel is opened, NULL for
+*                                               the registered techniques
+*                                               preferring WebSockets
+*           const unsigned int count            number of techniques
+*           const int   background              non zero: return at once
+*                                               and warm up from a thread
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_UNKNOWN_TECHNIQUE_ID
+*                    ACCL_ERROR              Anything else (portal not
+*                                            reachable, channel failed)
+* PROCESS :
+*                   [1]  Initialize cURL and resolve the portal addresses
+*                   [2]  Open ACCL_WARMUP_CONNECTIONS keep-alive connections
+*                        to every portal node
+*                   [3]  Open the WebSockets channel of every technique; the
+*                        next acclWebSocketInit of that technique returns it
+*                        instead of connecting
+*
+* NOTES :           server messages reaching a warmed up channel before
+*                   acclWebSocketInit claims it are dropped
+*/
+ACCL_EXTERN int acclWarmup (
+	const int* techniqueIds,
+	const unsigned int count,
+	const int background
+);
+
+/* retry policy flags (see acclSetRetryPolicy) */
+#define ACCL_RETRY_IDEMPOTENT	1		/* safe to repeat once the portal got it */
+#define ACCL_RETRY_HEDGE		2		/* hedge slow exchanges (needs ACCL_RETRY_IDEMPOTENT) */
+
+/*******************************************************************
+* NAME :            acclSetRetryPolicy
+*
+* DESCRIPTION :     Configure how failed requests of a technique are
+*		    retried, and whether its exchanges are hedged
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   T_ID                    technique unique identifier
+*           const unsigned int attempts         maximum number of attempts,
+*                                               1 for no retries
+*           const unsigned int backoff          first retry delay (ms)
+*           const unsigned int maxBackoff       retry delay cap (ms)
+*           const int   flags                   ACCL_RETRY_* flags
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_UNKNOWN_TECHNIQUE_ID
+*                    ACCL_GENERIC_ERROR      too many techniques configured
+* PROCESS :
+*                   [1]  Requests that never reached the portal (DNS or
+*                        connection failures) are retried
+*                   [2]  With ACCL_RETRY_IDEMPOTENT, timeouts, transfer
+*                        errors and HTTP 408/429/5xx are retried as well
+*                   [3]  Retry n waits a random time up to
+*                        min(maxBackoff, backoff * 2^(n-1)) milliseconds
+*                   [4]  With ACCL_RETRY_HEDGE, an exchange still pending
+*                        after the observed ACCL_HEDGE_QUANTILE latency is
+*                        sent a second time; the first response wins
+*                   [5]  Dropped WebSockets channels of the technique are
+*                        reconnected after the same backoff; with
+*                        ACCL_RETRY_IDEMPOTENT, exchanges written before
+*                        the drop are sent again
+*
+* NOTES :           per-call deadlines bound the retries as a whole;
+*                   chunked uploads are never retried, streamed and
+*                   asynchronous exchanges are never hedged
+*/
+ACCL_EXTERN int acclSetRetryPolicy (
+	const int T_ID,
+	const unsigned int attempts,
+	const unsigned int backoff,
+	const unsigned int maxBackoff,
+	const int flags
+);
+
+/*******************************************************************
+* NAME :            acclCacheEnable
+*
+* DESCRIPTION :     Enable (or disable) the response cache for the
+*		    exchanges of a technique
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   T_ID                    technique unique identifier
+*           const unsigned int ttl              entries time to live in
+*                                               seconds, 0 disables caching
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_ERROR              Anything else
+* PROCESS :
+*                   [1]  Synchronous exchanges of T_ID with the same
+*                        payload are answered from the cache, without any
+*                        network traffic, until the entry expires
+*
+* NOTES :           only for idempotent exchanges; streamed responses are
+*                   served from the cache but never stored
+*/
+ACCL_EXTERN int acclCacheEnable (
+	const int T_ID,
+	const unsigned int ttl
+);
+
+/*******************************************************************
+* NAME :            acclCacheConfigure
+*
+* DESCRIPTION :     Set the response cache limits and disk tier
+*
+* INPUTS :
+*       PARAMETERS:
+*           const unsigned int memoryBudget     memory tier size in bytes,
+*                                               least recently used entries
+*                                               are evicted beyond it
+*           const char* diskPath                disk tier directory, NULL
+*                                               disables the disk tier;
+*                                               bounded by
+*                                               ACCL_CACHE_DISK_BUDGET,
+*                                               oldest written files are
+*                                               removed beyond it
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_ERROR              Anything else, e.g. a
+*                                            diskPath too long
+*/
+ACCL_EXTERN int acclCacheConfigure (
+	const unsigned int memoryBudget,
+	const char* diskPath
+);
+
+/* completion callback for asynchronous exchanges */
+typedef void (* accl_exchange_callback)(
+	int error,
+	unsigned int returnBufferSize,
+	char* pReturnBuffer,
+	void* user_data
+);
+
+/*******************************************************************
+* NAME :            acclExchangeAsync
+*
+* DESCRIPTION :     Send a request to the ASPIRE aspire-portal without
+*		    blocking; the response is delivered to a callback
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   T_ID                    technique unique identifier
+*           const int   payloadBufferSize       payload buffer size in bytes
+*           const char* pPayloadBuffer          payload buffer (copied)
+*           accl_exchange_callback callback     completion callback
+*           void*       user_data               passed back to the callback
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0 (request queued)
+*                    ACCL_ERROR              Anything else (callback not invoked)
+* PROCESS :
+*                   [1]  Queue the payload on the ACCL I/O thread
+*                   [2]  Invoke callback with the same error code and return
+*                        buffer acclExchange would have produced; the callback
+*                        owns (and must free) the return buffer
+*
+* NOTES :           callbacks run on the ACCL I/O thread and should not block
+*/
+ACCL_EXTERN int acclExchangeAsync (
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	accl_exchange_callback callback,
+	void* user_data
+);
+
+/* single request of an acclExchangeBatch call */
+typedef struct accl_batch_entry {
+	int technique_id;					/* [in] technique unique identifier */
+	int payload_size;					/* [in] payload buffer size in bytes */
+	const char* payload_buffer;			/* [in] payload buffer */
+	unsigned int return_buffer_size;	/* [out] return buffer size in bytes */
+	char* return_buffer;				/* [out] return buffer */
+	int error;							/* [out] entry error code */
+} accl_batch_entry;
+
+/*******************************************************************
+* NAME :            acclExchangeBatch
+*
+* DESCRIPTION :     Send several requests to the ASPIRE aspire-portal
+*		    concurrently, waiting for all the responses
+*
+* INPUTS :
+*       PARAMETERS:
+*           accl_batch_entry* entries           [in/out] requests
+*           const unsigned int count            number of entries
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*           accl_batch_entry* entries           return buffer, its size and
+*                                               the error code of each entry
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0 (every entry succeeded)
+*                    ACCL_BATCH_ERROR        at least one entry failed
+*                    ACCL_ERROR              Anything else
+* PROCESS :
+*                   [1]  Multiplex every payload on the ACCL I/O thread
+*                   [2]  Wait for all the responses
+*                   [3]  Fill each entry as acclExchange would have done
+*/
+ACCL_EXTERN int acclExchangeBatch (
+	accl_batch_entry* entries,
+	const unsigned int count
+);
+
+/* number of error codes tracked per technique, every ACCL return value plus
+   a last slot counting any other code */
+#define ACCL_STATS_ERROR_SLOTS		19
+
+/* per technique metrics snapshot, latencies in microseconds */
+typedef struct accl_stats {
+	int technique_id;							/* technique unique identifier, 0 for all */
+	unsigned long long calls;					/* completed calls */
+	unsigned long long errors;					/* calls not returning ACCL_SUCCESS */
+	unsigned long long retries;					/* transport retries */
+	unsigned long long hedges;					/* hedged requests fired */
+	unsigned long long bytes_sent;				/* payload bytes */
+	unsigned long long bytes_received;			/* response bytes */
+	unsigned long long latency_mean;
+	unsigned long long latency_p50;
+	unsigned long long latency_p90;
+	unsigned long long latency_p99;
+	unsigned long long latency_p999;
+	unsigned long long latency_max;
+	struct {
+		int code;								/* ACCL return value, -1 for any other */
+		unsigned long long count;
+	} error_codes[ACCL_STATS_ERROR_SLOTS];		/* distribution of the returned codes */
+} accl_stats;
+
+/*******************************************************************
+* NAME :            acclGetStats
+*
+* DESCRIPTION :     Read the metrics collected for a technique
+*
+* INPUTS :
+*       PARAMETERS:
+*           const int   T_ID                    technique unique identifier,
+*                                               0 aggregates every technique
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*           accl_stats* stats                   metrics snapshot
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_ERROR              Anything else
+* PROCESS :
+*                   [1]  Merge the per-thread counters of T_ID
+*                   [2]  Compute the latency percentiles from the merged
+*                        histogram
+*
+* NOTES :           covers HTTP (sync, async, batch) and WebSocket calls;
+*                   percentiles are accurate to 1/8 of their magnitude
+*/
+ACCL_EXTERN int acclGetStats (
+	const int T_ID,
+	accl_stats* stats
+);
+
+/*******************************************************************
+* NAME :            acclStatsDump
+*
+* DESCRIPTION :     Append the metrics of every technique to a file,
+*		    once or periodically
+*
+* INPUTS :
+*       PARAMETERS:
+*           const char* path                    destination file
+*           const unsigned int interval         seconds between dumps,
+*                                               0 dumps once right away
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_ERROR              Anything else
+* PROCESS :
+*                   [1]  interval == 0: write one line per technique
+*                   [2]  otherwise: start (or retarget) a background thread
+*                        writing the same lines every interval seconds
+*/
+ACCL_EXTERN int acclStatsDump (
+	const char* path,
+	const unsigned int interval
+);
+
+/* preferred transport of a technique */
+#define ACCL_TRANSPORT_HTTP				0
+#define ACCL_TRANSPORT_WEBSOCKETS		1
+
+/* priority classes: asynchronous requests of higher classes are sent first */
+#define ACCL_PRIORITY_BACKGROUND		0	/* in flight requests capped by ACCL_ASYNC_BACKGROUND_LIMIT */
+#define ACCL_PRIORITY_NORMAL			1
+#define ACCL_PRIORITY_INTERACTIVE		2
+
+/* compression setting of a technique */
+#define ACCL_COMPRESSION_INHERIT		-1	/* client setting (see acclSetCompression) */
+
+/* WebSockets sends queued beyond the channel byte budget */
+#define ACCL_WS_BACKPRESSURE_BLOCK		0	/* wait for the queue to drain */
+#define ACCL_WS_BACKPRESSURE_FAIL		1	/* return ACCL_WS_QUEUE_FULL */
+
+/* technique registry entry: identifier, WebSockets port and default policy;
+   per client settings (acclCacheEnable, acclSetRetryPolicy, deadlines)
+   take precedence over the registry */
+typedef struct accl_technique {
+	int technique_id;							/* technique unique identifier */
+	int transport;								/* ACCL_TRANSPORT_* */
+	int ws_port;								/* WebSockets server port, 0 for the portal one */
+	unsigned int timeout;						/* request deadline in ms, 0 for the client timeouts */
+	int compression;							/* 0 off, 1 on, ACCL_COMPRESSION_INHERIT */
+	unsigned int cache_ttl;						/* seconds, 0 not cached */
+	unsigned int retry_attempts;				/* 1 for no retries (see acclSetRetryPolicy) */
+	unsigned int retry_backoff;					/* ms */
+	unsigned int retry_max_backoff;				/* ms */
+	int retry_flags;							/* ACCL_RETRY_* */
+	int priority;								/* ACCL_PRIORITY_* */
+	unsigned int ws_queue_budget;				/* bytes, 0 for ACCL_WS_QUEUE_BUDGET */
+	int ws_backpressure;						/* ACCL_WS_BACKPRESSURE_* */
+	int ws_deflate;								/* 0 off (built-in techniques), 1 offered */
+	unsigned int ws_deflate_window_bits;		/* 9 to 15, 0 for ACCL_WS_DEFLATE_WINDOW_BITS */
+	unsigned int ws_deflate_mem_level;			/* 1 to 9, 0 for ACCL_WS_DEFLATE_MEM_LEVEL */
+} accl_technique;
+
+/*******************************************************************
+* NAME :            acclRegisterTechnique
+*
+* DESCRIPTION :     Add a technique to the registry, or replace the
+*		    entry of a known one
+*
+* INPUTS :
+*       PARAMETERS:
+*           const accl_technique* technique     identifier and policy
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_UNKNOWN_TECHNIQUE_ID   identifier not valid
+*                    ACCL_GENERIC_ERROR      invalid policy, registry full
+* PROCESS :
+*                   [1]  The registry starts with the techniques of
+*                        D1.04 (see ACCL_TID_*)
+*                   [2]  Requests of a registered technique are accepted
+*                        and use its policy from the next call on
+*
+* NOTES :           the registry is shared by every client of the process
+*/
+ACCL_EXTERN int acclRegisterTechnique (
+	const accl_technique* technique
+);
+
+/*******************************************************************
+* NAME :            acclGetTechnique
+*
+* DESCRIPTION :     Read the registry entry of a technique
 *
 * INPUTS :
 *       PARAMETERS:
 *           const int   T_ID                    technique unique identifier
-*           const int   payloadBufferSize       payload buffer size in bytes
-*           const char* pPayloadBuffer          payload buffer
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*           accl_technique* technique           registry entry copy
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   int                    Error code:
+*            Values: ACCL_SUCCESS            0
+*                    ACCL_UNKNOWN_TECHNIQUE_ID
+*/
+ACCL_EXTERN int acclGetTechnique (
+	const int T_ID,
+	accl_technique* technique
+);
+
+/* ACCL client: portal configuration, connection pools, cache and metrics */
+typedef struct accl_client accl_client;
+
+/*******************************************************************
+* NAME :            acclClientCreate
+*
+* DESCRIPTION :     Create a client bound to one ASPIRE Portal (or a
+*		    set of equivalent portal nodes)
+*
+* INPUTS :
+*       PARAMETERS:
+*           const char* endpoint                ASPIRE Portal URL(s), NULL
+*                                               reads ACCL_FILE_PATH/
+*                                               ASPIREendpoint or uses the
+*                                               default
+*           const char* applicationId           NULL asks getApplicationId
+*           const char* wsHost                  WebSockets host(s), NULL reads
+*                                               ACCL_FILE_PATH/ASPIREhost or
+*                                               uses the default
+*       GLOBALS :
+*           None
+* OUTPUTS :
+*       PARAMETERS:
+*	     None
+*       GLOBALS :
+*            None
+*       RETURN :
+*            Type:   accl_client*           client handle, NULL on failure
+* PROCESS :
+*                   [1]  Resolve the configuration once
+*                   [2]  Set up the client's connection pool, response
+*                        cache, compression state and metrics
+*
+* NOTES :           the acclClient* variants of the APIs take the client
+*                   as first parameter and otherwise behave as the
+*                   functions they are named after; the client-less APIs
+*                   use a default client created on first use
+*/
+ACCL_EXTERN accl_client* acclClientCreate (
+	const char* endpoint,
+	const char* applicationId,
+	const char* wsHost
+);
+
+/*******************************************************************
+* NAME :            acclClientDestroy
+*
+* DESCRIPTION :     Release a client created by acclClientCreate
+*
+* INPUTS :
+*       PARAMETERS:
+*           accl_client* client                 client handle
 *       GLOBALS :
 *           None
 * OUTPUTS :
@@ -73,14 +999,176 @@ ACCL_EXTERN int acclExchange (
 *            Values: ACCL_SUCCESS            0
 *                    ACCL_ERROR              Anything else
 * PROCESS :
-*                   [1]  Send payload to the ASPIRE aspire-portal
+*                   [1]  Wait for the outstanding asynchronous requests
+*                   [2]  Stop the client threads, close its connections
+*                        and free its memory cache and metrics
+*
+* NOTES :           no synchronous call may be in progress on the client;
+*                   the default client is never destroyed
 */
-ACCL_EXTERN int acclSend (
+ACCL_EXTERN int acclClientDestroy (
+	accl_client* client
+);
+
+ACCL_EXTERN int acclClientExchange (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer
+);
+
+ACCL_EXTERN int acclClientExchangeInto (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int returnBufferCapacity,
+	char* pReturnBuffer,
+	unsigned int* returnBufferSize
+);
+
+ACCL_EXTERN int acclClientExchangeV (
+	accl_client* client,
+	const int T_ID,
+	const accl_iovec* segments,
+	const unsigned int segmentCount,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer
+);
+
+ACCL_EXTERN int acclClientExchangeStream (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	accl_stream_callback callback,
+	void* user_data
+);
+
+ACCL_EXTERN int acclClientExchangeChunked (
+	accl_client* client,
+	const int T_ID,
+	accl_producer_callback producer,
+	void* user_data,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer
+);
+
+ACCL_EXTERN int acclClientSend (
+	accl_client* client,
 	const int T_ID,
 	const int payloadBufferSize,
 	const char* pPayloadBuffer
 );
 
+ACCL_EXTERN int acclClientExchangeDeadline (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int timeout,
+	unsigned int* returnBufferSize,
+	char** pReturnBuffer
+);
+
+ACCL_EXTERN int acclClientSendDeadline (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	const unsigned int timeout
+);
+
+ACCL_EXTERN int acclClientSendV (
+	accl_client* client,
+	const int T_ID,
+	const accl_iovec* segments,
+	const unsigned int segmentCount
+);
+
+ACCL_EXTERN int acclClientSendChunked (
+	accl_client* client,
+	const int T_ID,
+	accl_producer_callback producer,
+	void* user_data
+);
+
+ACCL_EXTERN int acclClientExchangeAsync (
+	accl_client* client,
+	const int T_ID,
+	const int payloadBufferSize,
+	const char* pPayloadBuffer,
+	accl_exchange_callback callback,
+	void* user_data
+);
+
+ACCL_EXTERN int acclClientExchangeBatch (
+	accl_client* client,
+	accl_batch_entry* entries,
+	const unsigned int count
+);
+
+ACCL_EXTERN int acclClientSetCompression (
+	accl_client* client,
+	const int enabled,
+	const unsigned int threshold
+);
+
+ACCL_EXTERN int acclClientSetTimeouts (
+	accl_client* client,
+	const unsigned int connectTimeout,
+	const unsigned int totalTimeout,
+	const unsigned int lowSpeedLimit,
+	const unsigned int lowSpeedTime
+);
+
+ACCL_EXTERN int acclClientWarmup (
+	accl_client* client,
+	const int* techniqueIds,
+	const unsigned int count,
+	const int background
+);
+
+ACCL_EXTERN int acclClientSetBalancing (
+	accl_client* client,
+	const int policy
+);
+
+ACCL_EXTERN int acclClientSetRetryPolicy (
+	accl_client* client,
+	const int T_ID,
+	const unsigned int attempts,
+	const unsigned int backoff,
+	const unsigned int maxBackoff,
+	const int flags
+);
+
+ACCL_EXTERN int acclClientCacheEnable (
+	accl_client* client,
+	const int T_ID,
+	const unsigned int ttl
+);
+
+ACCL_EXTERN int acclClientCacheConfigure (
+	accl_client* client,
+	const unsigned int memoryBudget,
+	const char* diskPath
+);
+
+ACCL_EXTERN int acclClientGetStats (
+	accl_client* client,
+	const int T_ID,
+	accl_stats* stats
+);
+
+ACCL_EXTERN int acclClientStatsDump (
+	accl_client* client,
+	const char* path,
+	const unsigned int interval
+);
+
 // comment this out to implement your own getApplicationId
 //#define EXTERNAL_GET_APPLICATION_ID
 
@@ -105,8 +1193,62 @@ void getApplicationId(char** ptr_to_string_to_be_filled);
 	#include <pthread.h>
 	#include <libwebsockets.h>
 
-	/* Maximum number of active WebSocket channels per application */
-	#define ACCL_MAX_WS_THREADS	64
+	/* Maximum number of open WebSocket channels per client, every channel
+	   of a client is a connection of one context serviced by one thread */
+	#ifndef ACCL_MAX_WS_THREADS
+		#define ACCL_MAX_WS_THREADS	64
+	#endif
+
+	/* first byte of the client messages: sends, exchanges and exchanges
+	   tagged with a 4 byte request id (big endian) the portal echoes in
+	   front of the response, so that they can be answered out of order */
+	#define ACCL_WS_SEND					0
+	#define ACCL_WS_EXCHANGE				1
+	#define ACCL_WS_TAGGED_EXCHANGE			2
+	#define ACCL_WS_TAG_SIZE				5
+
+	/* several small messages in one frame, each preceded by its 4 byte
+	   size (big endian) */
+	#define ACCL_WS_BATCH					3
+	#define ACCL_WS_BATCH_HEADER			4
+
+	/* per-message deflate, negotiated on every connection: the client
+	   offers the window bits it compresses with, the portal accepts with
+	   the ones it compresses with (both 1 byte, after the type); then
+	   either side may send ACCL_WS_DEFLATED messages, one raw deflate
+	   stream per direction of the messages they replace, sync flushed
+	   and without the trailing 00 00 ff ff (as RFC 7692 does) */
+	#define ACCL_WS_DEFLATE_OFFER			4
+	#define ACCL_WS_DEFLATED				5
+
+	/* 0: one untagged exchange in flight per channel, for portals that
+	   only know ACCL_WS_EXCHANGE */
+	#ifndef ACCL_WS_MULTIPLEX
+		#define ACCL_WS_MULTIPLEX			1
+	#endif
+
+	/* 0: one frame per message, for portals that do not know ACCL_WS_BATCH */
+	#ifndef ACCL_WS_COALESCE
+		#define ACCL_WS_COALESCE			1
+	#endif
+
+	/* 0: deflate never offered, for portals that do not know
+	   ACCL_WS_DEFLATE_OFFER */
+	#ifndef ACCL_WS_DEFLATE
+		#define ACCL_WS_DEFLATE				1
+	#endif
+
+	/* largest message coalesced with others */
+	#ifndef ACCL_WS_COALESCE_LIMIT
+		#define ACCL_WS_COALESCE_LIMIT		1024
+	#endif
+
+	/* pending exchanges table, a power of two */
+	#define ACCL_WS_PENDING_BUCKETS			64
+
+	struct accl_ws_exchange;
+	struct accl_ws_service;
+	struct accl_ws_deflate;
 
 	/*
 	 * The ACCL component implements a communication protocol via websocket
@@ -129,19 +1271,40 @@ void getApplicationId(char** ptr_to_string_to_be_filled);
 
 	/*
 		WS protocol initialization, takes technique id, a callback to be called
-		and returns a ws handle to the channel
+		and returns a ws handle to the channel; the handle is opaque, channels
+		share the libwebsockets context of their client
 	*/
 	ACCL_EXTERN struct libwebsocket_context*  acclWebSocketInit (
 		const int T_ID,
 		void* (* callback)(void*, size_t)
 	);
 
+	/* same as acclWebSocketInit, on an explicit client */
+	ACCL_EXTERN struct libwebsocket_context*  acclClientWebSocketInit (
+		accl_client* client,
+		const int T_ID,
+		void* (* callback)(void*, size_t)
+	);
+
+	/*
+		Queues a message on the channel and returns, the service thread
+		writes it; over the technique queue budget the call waits or
+		returns ACCL_WS_QUEUE_FULL (see ws_backpressure). A dropped
+		connection is reconnected in the background, queued messages wait
+		for it; the message being written when it dropped is lost
+	*/
 	ACCL_EXTERN int acclWebSocketSend (
 		struct libwebsocket_context* context,
 		const unsigned int payloadBufferSize,
 		const char* pPayloadBuffer
 	);
 
+	/*
+		Sends a request and waits for its response; when the connection
+		drops after the request was written, it is sent again on the new
+		one for ACCL_RETRY_IDEMPOTENT techniques, otherwise the call
+		returns ACCL_WS_CONNECTION_LOST
+	*/
 	ACCL_EXTERN int acclWebSocketExchange (
 		struct libwebsocket_context* context,
 		const unsigned int payloadBufferSize,
@@ -163,24 +1326,76 @@ void getApplicationId(char** ptr_to_string_to_be_filled);
 		void *in, 
 		size_t len);
 
+	/* outgoing message, built once in place after LWS_SEND_BUFFER_PRE_PADDING
+	   bytes and written in fragments of at most ACCL_MAX_WS_BUFFER_SIZE */
+	struct accl_ws_message {
+		struct accl_ws_message* next;	/* queue link */
+		unsigned char* data;
+		size_t size;
+	};
+
 	/* ASCL data sending logic */
 	struct accl_context_buffer {
-		/* sending buffer */
-		void* buffer_ptr;
-		size_t buffer_size;
+		/* outbound queue: pushed without locks by the application threads,
+		   drained by the service thread on LWS_CALLBACK_CLIENT_WRITEABLE */
+		struct accl_ws_message* queue_tail;	/* last pushed, atomic */
+		struct accl_ws_message* queue_head;	/* service thread only, as below */
+		struct accl_ws_message queue_stub;
+		struct accl_ws_message* sending;	/* being written */
+		struct accl_ws_message* writing;	/* sending as written: itself or deflated */
+		struct accl_ws_message* next_message;	/* popped, not coalesced */
+		size_t send_offset;				/* bytes of sending already written */
+		size_t queued_bytes;			/* atomic */
+		size_t queue_budget;
+		int backpressure;				/* ACCL_WS_BACKPRESSURE_* */
+		unsigned int queue_waiters;		/* atomic */
+
+		/* coalesced messages, behind the padding of send_buffer */
+		struct accl_ws_message batch;
+		unsigned char* send_buffer;
+
+		/* per-message deflate of the connection, NULL when not offered */
+		struct accl_ws_deflate* deflate;
+
+		/* incoming message reassembly */
+		unsigned char* receive_buffer;
+		size_t receive_capacity;
+		size_t receive_size;
 
-		/* receiving buffer */
-		void* response_buffer_ptr;
-		size_t response_buffer_size;
+		/* exchanges waiting for their response, by request id */
+		struct accl_ws_exchange* pending[ACCL_WS_PENDING_BUCKETS];
+		unsigned int pending_count;
+		unsigned int next_id;
 
-		int wait_for_response;
 		int technique_id;
+		accl_client* client;
+		int portal;					/* WebSockets host, -1 until connected */
 		void* (* callback)(void*, size_t);
 
-		int initialization_complete;
-		int send_in_progress;
+		int initialization_complete;	/* 0 connecting or reconnecting, 1 open, 2 closed */
+		int closing;					/* acclWebSocketShutdown called */
+		int orphaned;					/* freed by the service thread once closed */
+		int references;					/* atomic: the handle and the calls in flight */
 
-		struct libwebsocket_protocols* protocols;
+		/* reconnection of a dropped channel, service thread only */
+		int opened;						/* established once at least */
+		unsigned int reconnect_attempt;	/* in a row, 0 while connected */
+		unsigned long long reconnect_at;	/* acclNow() of the next attempt, 0: none due */
+		unsigned int reconnect_backoff;	/* first delay and cap, ms */
+		unsigned int reconnect_max_backoff;
+		int reissue;					/* written exchanges are sent again after a drop */
+
+		/* connection of the client context: the service thread is the
+		   only one calling into libwebsockets, application threads wait
+		   on done */
+		struct accl_ws_service* service;
+		struct libwebsocket* wsi;		/* service thread only */
+		pthread_mutex_t mutex;			/* protects the state above */
+		pthread_cond_t done;			/* queue drained, response received or channel closed */
+		int slot;						/* in the service channel table */
+		int node;						/* WebSockets host connected to */
+		int connect_requested;			/* protected by the service mutex */
+		int write_requested;			/* writeable callback wanted, atomic */
 	};
 #endif	/* WITHOUT_WEBSOCKETS */
 
@@ -211,13 +1426,181 @@ void getApplicationId(char** ptr_to_string_to_be_filled);
 #define ACCL_RA_ATTESTATOR_9			9009
 #define ACCL_TID_TEST					9999
 
-/* Requests timeout */
-#define ACCL_RESPONSE_TIMEOUT			10L
+/* technique registry slots (see acclRegisterTechnique), a power of two */
+#define ACCL_REGISTRY_SIZE				256
+
+/* HTTP request timeouts (see acclSetTimeouts) */
+#ifndef ACCL_RESPONSE_TIMEOUT
+	#define ACCL_RESPONSE_TIMEOUT			10L			/* seconds, whole request */
+#endif
+
+#ifndef ACCL_CONNECT_TIMEOUT
+	#define ACCL_CONNECT_TIMEOUT			3000L		/* milliseconds */
+#endif
+
+/* transfers slower than ACCL_LOW_SPEED_LIMIT bytes/s for ACCL_LOW_SPEED_TIME seconds are aborted;
+   off by default: no bytes flow while the portal computes its response */
+#ifndef ACCL_LOW_SPEED_LIMIT
+	#define ACCL_LOW_SPEED_LIMIT			0L
+#endif
+
+#ifndef ACCL_LOW_SPEED_TIME
+	#define ACCL_LOW_SPEED_TIME				5L
+#endif
 
 /* payload max size */
 #define ACCL_MAX_BUFFER_SIZE			(1 << 22)
 #define ACCL_BLOCK_SIZE					(1 << 22)
-#define ACCL_MAX_WS_BUFFER_SIZE			16384
+
+/* largest WebSockets frame written at once, longer messages are fragmented */
+#ifndef ACCL_MAX_WS_BUFFER_SIZE
+	#define ACCL_MAX_WS_BUFFER_SIZE			16384
+#endif
+
+/* bytes queued on a WebSockets channel before sends feel backpressure */
+#ifndef ACCL_WS_QUEUE_BUDGET
+	#define ACCL_WS_QUEUE_BUDGET			(1 << 22)
+#endif
+
+/* per-message deflate defaults (see ws_deflate): zlib window bits and
+   memory level, smallest message compressed */
+#ifndef ACCL_WS_DEFLATE_WINDOW_BITS
+	#define ACCL_WS_DEFLATE_WINDOW_BITS		15
+#endif
+
+#ifndef ACCL_WS_DEFLATE_MEM_LEVEL
+	#define ACCL_WS_DEFLATE_MEM_LEVEL		8
+#endif
+
+#ifndef ACCL_WS_DEFLATE_THRESHOLD
+	#define ACCL_WS_DEFLATE_THRESHOLD		128
+#endif
+
+/* WebSockets channel establishment limit and service thread idle wait, in milliseconds */
+#ifndef ACCL_WS_CONNECT_TIMEOUT
+	#define ACCL_WS_CONNECT_TIMEOUT			5000
+#endif
+
+#ifndef ACCL_WS_SERVICE_TIMEOUT
+	#define ACCL_WS_SERVICE_TIMEOUT			1000
+#endif
+
+/* dropped WebSockets channels are reconnected up to ACCL_WS_RECONNECT_ATTEMPTS
+   times in a row (0: never), after a jittered exponential backoff in
+   milliseconds the technique retry policy overrides */
+#ifndef ACCL_WS_RECONNECT_ATTEMPTS
+	#define ACCL_WS_RECONNECT_ATTEMPTS		8
+#endif
+
+#ifndef ACCL_WS_RECONNECT_BACKOFF
+	#define ACCL_WS_RECONNECT_BACKOFF		100
+#endif
+
+#ifndef ACCL_WS_RECONNECT_MAX_BACKOFF
+	#define ACCL_WS_RECONNECT_MAX_BACKOFF	5000
+#endif
+
+/* ACCL I/O thread maximum idle wait, in milliseconds */
+#ifndef ACCL_ASYNC_POLL_TIMEOUT
+	#define ACCL_ASYNC_POLL_TIMEOUT			1000
+#endif
+
+/* asynchronous ACCL_PRIORITY_BACKGROUND requests in flight per client */
+#ifndef ACCL_ASYNC_BACKGROUND_LIMIT
+	#define ACCL_ASYNC_BACKGROUND_LIMIT		((ACCL_HTTP_POOL_SIZE + 1) / 2)
+#endif
+
+/* first response buffer allocation when no Content-Length is announced */
+#ifndef ACCL_RESPONSE_INITIAL_SIZE
+	#define ACCL_RESPONSE_INITIAL_SIZE		4096
+#endif
+
+/* chunk size of producer driven (chunked) uploads */
+#ifndef ACCL_UPLOAD_CHUNK_SIZE
+	#define ACCL_UPLOAD_CHUNK_SIZE			65536
+#endif
+
+/* HTTP payload compression default (see acclSetCompression) */
+#ifndef ACCL_COMPRESSION
+	#define ACCL_COMPRESSION				0
+#endif
+
+#ifndef ACCL_COMPRESSION_THRESHOLD
+	#define ACCL_COMPRESSION_THRESHOLD		1024
+#endif
+
+/* response cache defaults (see acclCacheEnable) */
+#ifndef ACCL_CACHE_MEMORY_BUDGET
+	#define ACCL_CACHE_MEMORY_BUDGET		(1 << 24)
+#endif
+
+/* disk tier size in bytes, the oldest files are removed beyond it */
+#ifndef ACCL_CACHE_DISK_BUDGET
+	#define ACCL_CACHE_DISK_BUDGET			(1 << 26)
+#endif
+
+#define ACCL_CACHE_BUCKETS				256
+#define ACCL_CACHE_MAX_TECHNIQUES		32
+
+/* portal nodes per client and their health checks, in milliseconds (see acclSetBalancing) */
+#define ACCL_MAX_PORTALS				8
+
+#ifndef ACCL_BALANCE
+	#define ACCL_BALANCE					ACCL_BALANCE_LEAST_OUTSTANDING
+#endif
+
+#ifndef ACCL_PORTAL_HEALTH_INTERVAL
+	#define ACCL_PORTAL_HEALTH_INTERVAL		5000
+#endif
+
+#ifndef ACCL_PORTAL_DOWN_TIME
+	#define ACCL_PORTAL_DOWN_TIME			30000
+#endif
+
+/* latency EWMA smoothing: each sample weighs 1/ACCL_PORTAL_EWMA_WEIGHT */
+#ifndef ACCL_PORTAL_EWMA_WEIGHT
+	#define ACCL_PORTAL_EWMA_WEIGHT			8
+#endif
+
+/* warm-up: connections opened per portal node, channels kept until claimed (see acclWarmup) */
+#ifndef ACCL_WARMUP_CONNECTIONS
+	#define ACCL_WARMUP_CONNECTIONS			2
+#endif
+
+#define ACCL_WARMUP_MAX_CHANNELS		16
+
+/* resolved portal addresses lifetime, in seconds */
+#ifndef ACCL_DNS_CACHE_TIMEOUT
+	#define ACCL_DNS_CACHE_TIMEOUT			300
+#endif
+
+/* retry policies and hedging (see acclSetRetryPolicy) */
+#define ACCL_RETRY_MAX_TECHNIQUES		32
+
+#ifndef ACCL_HEDGE_QUANTILE
+	#define ACCL_HEDGE_QUANTILE				0.95
+#endif
+
+/* calls observed before hedging starts, and hedge delay refresh period (ms) */
+#ifndef ACCL_HEDGE_MIN_SAMPLES
+	#define ACCL_HEDGE_MIN_SAMPLES			20
+#endif
+
+#ifndef ACCL_HEDGE_REFRESH
+	#define ACCL_HEDGE_REFRESH				1000
+#endif
+
+/* maximum number of idle keep-alive cURL handles kept by the HTTP pool */
+#ifndef ACCL_HTTP_POOL_SIZE
+	#define ACCL_HTTP_POOL_SIZE				16
+#endif
+
+/* metrics: per-thread counter shards and tracked techniques */
+#ifndef ACCL_STATS_SHARDS
+	#define ACCL_STATS_SHARDS				8
+#endif
+
+#define ACCL_STATS_MAX_TECHNIQUES		64
 
 /* ACCL Return values */
 #define ACCL_SUCCESS							0
@@ -226,13 +1609,20 @@ void getApplicationId(char** ptr_to_string_to_be_filled);
 #define ACCL_INPUT_BUFFER_MAX_SIZE_EXCEEDED		11
 #define ACCL_OUTPUT_BUFFER_MAX_SIZE_EXCEEDED	12
 #define ACCL_OUTPUT_BUFFER_ALLOCATION_ERROR		15
+#define ACCL_STREAM_ABORTED						16
+#define ACCL_PRODUCER_ABORTED					17
 #define ACCL_UNKNOWN_TECHNIQUE_ID				20
+#define ACCL_INVALID_CLIENT						25
+#define ACCL_BATCH_ERROR						30
+#define ACCL_TIMEOUT							40
 
 #define ACCL_SERVER_ERROR						100
 
 /* WebSockets specific return values */
 #define ACCL_WS_INVALID_CONTEXT					501
 #define ACCL_WS_ALREADY_SHUT_DOWN				502
+#define ACCL_WS_QUEUE_FULL						503
+#define ACCL_WS_CONNECTION_LOST					504
 
 #define ACCL_GENERIC_ERROR						1000
 
@@ -255,6 +1645,13 @@ void getApplicationId(char** ptr_to_string_to_be_filled);
 
 #ifndef NDEBUG
 	#define ACCL_LOG_FILE			"accl.log"
+
+	/* log records ring (a power of two) and writer batch size */
+	#ifndef ACCL_LOG_RING_SIZE
+		#define ACCL_LOG_RING_SIZE		256
+	#endif
+
+	#define ACCL_LOG_BATCH_SIZE		(1 << 16)
 #endif
 
 /* current logging level */
@@ -282,6 +1679,10 @@ void getApplicationId(char** ptr_to_string_to_be_filled);
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #endif
 
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
 /* structure used for receiving data from server see: cURL CURLOPT_READDATA  */
 typedef struct accl_payload_transfer {
 	int technique_id;			/* technique id */
@@ -290,6 +1691,19 @@ typedef struct accl_payload_transfer {
 	char* payload_buffer;		/* payload buffer */
 	int transmit_offset;		/* current offset in data transmitting */
 	int error;					/* will eventually contain error code */
+	const accl_iovec* segments;	/* payload segments (NULL: payload_buffer) */
+	unsigned int segment_count;	/* number of payload segments */
+	unsigned int segment_index;	/* segment being transmitted */
+	unsigned int segment_offset;	/* offset in the segment being transmitted */
+	accl_producer_callback producer;	/* chunked upload payload producer */
+	void* producer_user_data;	/* passed back to producer */
+	void* http_headers;			/* extra request headers (struct curl_slist*) */
+	void* encoded_buffer;		/* compressed payload (NULL: not compressed) */
+	unsigned int encoded_size;	/* compressed payload size */
+	unsigned int timeout;		/* request deadline in ms (0: client timeouts) */
+	int compression;			/* technique setting, ACCL_COMPRESSION_INHERIT */
+	int failure;				/* retry class of the last failure */
+	int answered;				/* the portal sent an HTTP response back */
 } accl_payload_transfer;
 
 /* structure used as userdata see: cURL CURLOPT_WRITEDATA  */
@@ -297,13 +1711,22 @@ typedef struct accl_response {
 	unsigned int output_buffer_size;	/* output buffer size */
 	char* output_buffer;				/* output buffer */
 	int error;							/* will eventually contain error code */
+	unsigned int output_buffer_capacity;	/* bytes allocated for output buffer */
+	int external_buffer;				/* output buffer supplied by the caller */
+	void* curl_handle;					/* transfer handle (Content-Length lookup) */
+	accl_stream_callback stream_callback;	/* streaming mode chunk consumer */
+	void* stream_user_data;				/* passed back to stream_callback */
 } accl_response;
 
 //#undef NDEBUG
 
 /* internal ACCL procedures */
 #ifndef NDEBUG
-	void acclLOG(const char* tag, const char* fmt, int lvl, ...);
+	void acclLOG(const char* tag, const char* fmt, int lvl, ...)
+	#ifdef __GNUC__
+		__attribute__((format(printf, 2, 4)))
+	#endif
+	;
 #endif
 
 size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userdata);